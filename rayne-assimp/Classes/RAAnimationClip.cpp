@@ -0,0 +1,114 @@
+//
+//  RAAnimationClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAAnimationClip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(AnimationClip, Clip)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: AnimationClip
+		// ---------------------
+		
+		AnimationClip::AnimationClip(NameID name, size_t boneCount, float duration, float sampleRate) :
+			Clip(name, boneCount),
+			_frameCount(CountFrames(duration, sampleRate)),
+			_sampleRate(sampleRate),
+			_duration(std::max(duration, 0.0f))
+		{
+			_positions.resize(_boneCount * _frameCount * 3, 0.0f);
+			_rotations.resize(_boneCount * _frameCount * 4, 0.0f);
+			_scales.resize(_boneCount * _frameCount * 3, 1.0f);
+			
+			for(size_t i = 3; i < _rotations.size(); i += 4)
+				_rotations[i] = 1.0f;
+		}
+		
+		size_t AnimationClip::GetMemorySize() const
+		{
+			return (_positions.size() + _rotations.size() + _scales.size()) * sizeof(float);
+		}
+		
+		void AnimationClip::GetFrames(float time, size_t &frame, size_t &next, float &factor) const
+		{
+			float position = GetFramePosition(time, _duration, _sampleRate, _frameCount);
+			
+			frame = std::min(static_cast<size_t>(position), _frameCount - 1);
+			next = std::min(frame + 1, _frameCount - 1);
+			factor = position - frame;
+		}
+		
+		void AnimationClip::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			size_t frame, next;
+			float factor;
+			
+			GetFrames(WrapTime(time, _duration), frame, next, factor);
+			
+			for(size_t bone = 0; bone < _boneCount; bone ++)
+			{
+				const float *p0 = &_positions[(bone * _frameCount + frame) * 3];
+				const float *p1 = &_positions[(bone * _frameCount + next) * 3];
+				const float *s0 = &_scales[(bone * _frameCount + frame) * 3];
+				const float *s1 = &_scales[(bone * _frameCount + next) * 3];
+				const float *r0 = &_rotations[(bone * _frameCount + frame) * 4];
+				const float *r1 = &_rotations[(bone * _frameCount + next) * 4];
+				
+				float position[3];
+				float rotation[4];
+				float scale[3];
+				
+				InterpolateVector(p0, p1, factor, position);
+				InterpolateRotation(r0, r1, factor, rotation);
+				InterpolateVector(s0, s1, factor, scale);
+				
+				positions[bone] = Vector3(position[0], position[1], position[2]);
+				rotations[bone] = Quaternion(rotation[0], rotation[1], rotation[2], rotation[3]);
+				scales[bone] = Vector3(scale[0], scale[1], scale[2]);
+			}
+		}
+		
+		AnimationClip *AnimationClip::Resample(float sampleRate) const
+		{
+			AnimationClip *clip = new AnimationClip(_name, _boneCount, _duration, sampleRate);
+			
+			for(size_t frame = 0; frame < clip->_frameCount; frame ++)
+			{
+				// Interpolates the source frames directly, sampling would wrap the last frame around to the first
+				size_t source, next;
+				float factor;
+				
+				GetFrames(std::min(frame / sampleRate, _duration), source, next, factor);
+				
+				for(size_t bone = 0; bone < _boneCount; bone ++)
+				{
+					InterpolateVector(GetPositions(bone) + source * 3, GetPositions(bone) + next * 3, factor, clip->GetPositions(bone) + frame * 3);
+					InterpolateRotation(GetRotations(bone) + source * 4, GetRotations(bone) + next * 4, factor, clip->GetRotations(bone) + frame * 4);
+					InterpolateVector(GetScales(bone) + source * 3, GetScales(bone) + next * 3, factor, clip->GetScales(bone) + frame * 3);
+				}
+			}
+			
+			return clip;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+//
+//  RAAnimationClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_ANIMATIONCLIP__
+#define __RAYNE_ASSIMP_ANIMATIONCLIP__
+
+#include <Rayne/Rayne.h>
+#include "RAClip.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Animation resampled at a fixed rate into contiguous buffers. Each track is stored bone major,
+		// all frames of bone 0 followed by all frames of bone 1 and so on, so finding the keys for
+		// a time is a multiplication instead of walking AnimationBone lists.
+		class AnimationClip : public Clip
+		{
+		public:
+			// The frame count follows from the duration, see Clip::CountFrames()
+			AnimationClip(NameID name, size_t boneCount, float duration, float sampleRate);
+			
+			size_t GetFrameCount() const { return _frameCount; }
+			float GetSampleRate() const { return _sampleRate; }
+			float GetDuration() const override { return _duration; }
+			size_t GetMemorySize() const override;
+			
+			float *GetPositions(size_t bone) { return &_positions[bone * _frameCount * 3]; }
+			float *GetRotations(size_t bone) { return &_rotations[bone * _frameCount * 4]; }
+			float *GetScales(size_t bone) { return &_scales[bone * _frameCount * 3]; }
+			const float *GetPositions(size_t bone) const { return &_positions[bone * _frameCount * 3]; }
+			const float *GetRotations(size_t bone) const { return &_rotations[bone * _frameCount * 4]; }
+			const float *GetScales(size_t bone) const { return &_scales[bone * _frameCount * 3]; }
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			
+			// Returns a new clip with the same motion and duration at another rate, eg. a cheaper variant for distant characters
+			AnimationClip *Resample(float sampleRate) const;
+			
+		private:
+			void GetFrames(float time, size_t &frame, size_t &next, float &factor) const;
+			
+			size_t _frameCount;
+			float _sampleRate;
+			float _duration;
+			
+			std::vector<float> _positions; // xyz
+			std::vector<float> _rotations; // xyzw
+			std::vector<float> _scales;    // xyz
+			
+			RNDeclareMeta(AnimationClip)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_ANIMATIONCLIP__ */
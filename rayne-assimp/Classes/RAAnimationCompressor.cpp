@@ -0,0 +1,210 @@
+//
+//  RAAnimationCompressor.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAAnimationCompressor.h"
+#include <algorithm>
+#include <cmath>
+
+#define kRACompressorMaxSegmentLength 256
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Distance between the interpolation of two decoded keys and the original value, rotations are
+		// measured as angle in radians
+		static float GetInterpolationError(const float *from, const float *to, const float *original, float factor, bool rotation)
+		{
+			if(rotation)
+			{
+				float sign = (from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3]) < 0.0f ? -1.0f : 1.0f;
+				float result[4];
+				float length = 0.0f;
+				
+				for(int i = 0; i < 4; i ++)
+				{
+					result[i] = from[i] + (to[i] * sign - from[i]) * factor;
+					length += result[i] * result[i];
+				}
+				
+				float dot = 0.0f;
+				for(int i = 0; i < 4; i ++)
+					dot += (result[i] / std::sqrt(length)) * original[i];
+				
+				return 2.0f * std::acos(std::min(std::fabs(dot), 1.0f));
+			}
+			
+			float distance = 0.0f;
+			for(int i = 0; i < 3; i ++)
+			{
+				float value = from[i] + (to[i] - from[i]) * factor - original[i];
+				distance += value * value;
+			}
+			
+			return std::sqrt(distance);
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: AnimationCompressor
+		// ---------------------
+		
+		AnimationCompressor::Settings::Settings() :
+			positionError(0.0001f),
+			vertexDistance(0.03f)
+		{}
+		
+		AnimationCompressor::AnimationCompressor(const SkeletonLayout *layout, const Settings &settings) :
+			_layout(layout),
+			_settings(settings)
+		{}
+		
+		CompressedClip *AnimationCompressor::Compress(const AnimationClip *clip) const
+		{
+			size_t boneCount = clip->GetBoneCount();
+			size_t frameCount = clip->GetFrameCount();
+			
+			if(frameCount > 65536 || boneCount != _layout->GetBoneCount())
+				return nullptr;
+			
+			// Longest chain below every bone, bones are ordered parent first so walking backwards visits children first
+			std::vector<float> reach(boneCount, 0.0f);
+			for(size_t bone = boneCount; bone -- > 0;)
+			{
+				int32 parent = _layout->GetParent(bone);
+				if(parent < 0)
+					continue;
+				
+				const float *positions = clip->GetPositions(bone);
+				float length = 0.0f;
+				
+				for(size_t frame = 0; frame < frameCount; frame ++)
+				{
+					const float *position = positions + frame * 3;
+					length = std::max(length, std::sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]));
+				}
+				
+				reach[parent] = std::max(reach[parent], reach[bone] + length);
+			}
+			
+			CompressedClip *compressed = new CompressedClip(clip->GetName(), boneCount, clip->GetDuration(), clip->GetSampleRate());
+			
+			for(size_t bone = 0; bone < boneCount; bone ++)
+			{
+				float radius = reach[bone] + _settings.vertexDistance;
+				float tolerance = (radius > k::EpsilonFloat) ? _settings.positionError / radius : _settings.positionError;
+				
+				CompressTrack(clip->GetPositions(bone), frameCount, false, _settings.positionError, compressed->GetPositionTrack(bone));
+				CompressTrack(clip->GetRotations(bone), frameCount, true, tolerance, compressed->GetRotationTrack(bone));
+				CompressTrack(clip->GetScales(bone), frameCount, false, tolerance, compressed->GetScaleTrack(bone));
+			}
+			
+			return compressed;
+		}
+		
+		void AnimationCompressor::CompressTrack(const float *values, size_t frameCount, bool rotation, float tolerance, CompressedClip::Track &track) const
+		{
+			size_t components = rotation ? 4 : 3;
+			
+			for(int i = 0; i < 3; i ++)
+			{
+				track.minimum[i] = 0.0f;
+				track.extent[i] = 0.0f;
+			}
+			
+			if(!rotation)
+			{
+				float maximum[3];
+				for(int i = 0; i < 3; i ++)
+				{
+					track.minimum[i] = values[i];
+					maximum[i] = values[i];
+				}
+				
+				for(size_t frame = 1; frame < frameCount; frame ++)
+				{
+					for(int i = 0; i < 3; i ++)
+					{
+						track.minimum[i] = std::min(track.minimum[i], values[frame * 3 + i]);
+						maximum[i] = std::max(maximum[i], values[frame * 3 + i]);
+					}
+				}
+				
+				for(int i = 0; i < 3; i ++)
+					track.extent[i] = maximum[i] - track.minimum[i];
+			}
+			
+			// Keys are chosen on the quantized values, so the tolerance covers the quantization error as well
+			std::vector<uint16> packed(frameCount * 3);
+			std::vector<float> decoded(frameCount * components);
+			
+			for(size_t frame = 0; frame < frameCount; frame ++)
+			{
+				if(rotation)
+				{
+					CompressedClip::PackRotation(values + frame * 4, &packed[frame * 3]);
+					CompressedClip::UnpackRotation(&packed[frame * 3], &decoded[frame * 4]);
+				}
+				else
+				{
+					CompressedClip::PackVector(values + frame * 3, track, &packed[frame * 3]);
+					CompressedClip::UnpackVector(&packed[frame * 3], track, &decoded[frame * 3]);
+				}
+			}
+			
+			auto fits = [&](size_t start, size_t end) -> bool {
+				for(size_t frame = start + 1; frame < end; frame ++)
+				{
+					float factor = static_cast<float>(frame - start) / static_cast<float>(end - start);
+					if(GetInterpolationError(&decoded[start * components], &decoded[end * components], values + frame * components, factor, rotation) > tolerance)
+						return false;
+				}
+				
+				return true;
+			};
+			
+			std::vector<uint16> keys;
+			keys.push_back(0);
+			
+			// A track that never leaves the tolerance around its first key collapses to a single key
+			bool constant = true;
+			for(size_t frame = 1; frame < frameCount && constant; frame ++)
+				constant = (GetInterpolationError(&decoded[0], &decoded[0], values + frame * components, 0.0f, rotation) <= tolerance);
+			
+			if(!constant)
+			{
+				size_t start = 0;
+				while(start < frameCount - 1)
+				{
+					size_t end = start + 1;
+					while(end + 1 < frameCount && end + 1 - start <= kRACompressorMaxSegmentLength && fits(start, end + 1))
+						end ++;
+					
+					keys.push_back(static_cast<uint16>(end));
+					start = end;
+				}
+			}
+			
+			track.frames = keys;
+			track.values.clear();
+			track.values.reserve(keys.size() * 3);
+			
+			for(uint16 key : keys)
+				track.values.insert(track.values.end(), packed.begin() + key * 3, packed.begin() + key * 3 + 3);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+//
+//  RAAnimationCompressor.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_ANIMATIONCOMPRESSOR__
+#define __RAYNE_ASSIMP_ANIMATIONCOMPRESSOR__
+
+#include <Rayne/Rayne.h>
+#include "RAAnimationClip.h"
+#include "RACompressedClip.h"
+#include "RASkeletonLayout.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Removes keys that linear interpolation can reproduce and quantizes the rest. The error budget is a
+		// distance in model space: a rotation or scale error on a bone moves everything further down the chain,
+		// so its tolerance shrinks with the length of the chain below it plus the virtual vertex distance.
+		class AnimationCompressor
+		{
+		public:
+			struct Settings
+			{
+				Settings();
+				
+				float positionError;  // Scene units
+				float vertexDistance; // Scene units the skin extends beyond the last bone of a chain
+			};
+			
+			AnimationCompressor(const SkeletonLayout *layout, const Settings &settings);
+			
+			// Returns nullptr if the clip can't be compressed, frame indices are stored in 16 bit
+			CompressedClip *Compress(const AnimationClip *clip) const;
+			
+		private:
+			void CompressTrack(const float *values, size_t frameCount, bool rotation, float tolerance, CompressedClip::Track &track) const;
+			
+			const SkeletonLayout *_layout;
+			Settings _settings;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_ANIMATIONCOMPRESSOR__ */
@@ -0,0 +1,123 @@
+//
+//  RAClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAClip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(Clip, Object)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Clip
+		// ---------------------
+		
+		Clip::Clip(NameID name, size_t boneCount) :
+			_name(name),
+			_boneCount(boneCount)
+		{}
+		
+		size_t Clip::CountFrames(float duration, float sampleRate)
+		{
+			// The tolerance keeps a rate that divides the duration from gaining a frame through rounding
+			float frames = std::ceil(duration * sampleRate - 0.001f);
+			return static_cast<size_t>(std::max(frames, 0.0f)) + 1;
+		}
+		
+		float Clip::GetFramePosition(float time, float duration, float sampleRate, size_t frameCount)
+		{
+			if(frameCount < 2)
+				return 0.0f;
+			
+			size_t last = frameCount - 1;
+			float position = std::max(time * sampleRate, 0.0f);
+			size_t frame = std::min(static_cast<size_t>(position), last);
+			
+			if(frame + 1 < last)
+				return position;
+			if(frame == last)
+				return static_cast<float>(last);
+			
+			// The final interval ends at the duration and is shorter when the rate doesn't divide it
+			float start = frame / sampleRate;
+			float span = duration - start;
+			
+			if(span <= 0.0f)
+				return static_cast<float>(last);
+			
+			return frame + std::min(std::max(time - start, 0.0f) / span, 1.0f);
+		}
+		
+		float Clip::WrapTime(float time, float duration)
+		{
+			if(duration <= 0.0f)
+				return 0.0f;
+			
+			time = std::fmod(time, duration);
+			return (time < 0.0f) ? time + duration : time;
+		}
+		
+		void Clip::InterpolateVector(const float *from, const float *to, float factor, float *result)
+		{
+			for(int i = 0; i < 3; i ++)
+				result[i] = from[i] + (to[i] - from[i]) * factor;
+		}
+		
+		void Clip::InterpolateRotation(const float *from, const float *to, float factor, float *result)
+		{
+			// Neighbouring keys are close together, a normalized lerp along the shorter arc is enough
+			float sign = (from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3]) < 0.0f ? -1.0f : 1.0f;
+			float length = 0.0f;
+			
+			for(int i = 0; i < 4; i ++)
+			{
+				result[i] = from[i] + (to[i] * sign - from[i]) * factor;
+				length += result[i] * result[i];
+			}
+			
+			length = std::sqrt(length);
+			for(int i = 0; i < 4; i ++)
+				result[i] /= length;
+		}
+		
+		void Clip::SlerpRotation(const float *from, const float *to, float factor, float *result)
+		{
+			// For keys that can be far apart, the normalized lerp doesn't keep a constant angular velocity
+			float dot = from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3];
+			float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+			
+			dot = std::min(std::fabs(dot), 1.0f);
+			if(dot > 0.9995f)
+			{
+				InterpolateRotation(from, to, factor, result);
+				return;
+			}
+			
+			float angle = std::acos(dot);
+			float sine = std::sin(angle);
+			float fromWeight = std::sin((1.0f - factor) * angle) / sine;
+			float toWeight = std::sin(factor * angle) / sine * sign;
+			
+			for(int i = 0; i < 4; i ++)
+				result[i] = from[i] * fromWeight + to[i] * toWeight;
+		}
+	}
+}
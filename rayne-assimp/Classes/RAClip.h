@@ -0,0 +1,65 @@
+//
+//  RAClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_CLIP__
+#define __RAYNE_ASSIMP_CLIP__
+
+#include <Rayne/Rayne.h>
+#include "RANameTable.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Common interface of the clip representations, each one samples the local pose of every bone
+		class Clip : public Object
+		{
+		public:
+			NameID GetName() const { return _name; }
+			size_t GetBoneCount() const { return _boneCount; }
+			
+			virtual float GetDuration() const = 0;
+			virtual size_t GetMemorySize() const = 0;
+			
+			// Time is in seconds and wraps around the duration
+			virtual void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const = 0;
+			
+			// Blocks until Sample() writes real poses, for clips that load their keys on demand
+			virtual void WaitUntilResident() const {}
+			
+			// Fixed rate clips put frame i at min(i / sampleRate, duration). The last frame holds the pose at the
+			// duration, so variants at different rates keep the source's loop period.
+			static size_t CountFrames(float duration, float sampleRate);
+			static float GetFramePosition(float time, float duration, float sampleRate, size_t frameCount);
+			
+		protected:
+			Clip(NameID name, size_t boneCount);
+			
+			static float WrapTime(float time, float duration);
+			static void InterpolateVector(const float *from, const float *to, float factor, float *result);
+			static void InterpolateRotation(const float *from, const float *to, float factor, float *result);
+			static void SlerpRotation(const float *from, const float *to, float factor, float *result);
+			
+			NameID _name;
+			size_t _boneCount;
+			
+			RNDeclareMeta(Clip)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_CLIP__ */
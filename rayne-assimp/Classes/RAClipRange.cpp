@@ -0,0 +1,51 @@
+//
+//  RAClipRange.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAClipRange.h"
+#include <algorithm>
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(ClipRange, Clip)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: ClipRange
+		// ---------------------
+		
+		ClipRange::ClipRange(NameID name, Clip *source, float start, float end) :
+			Clip(name, source->GetBoneCount()),
+			_source(source),
+			_start(std::max(0.0f, std::min(start, source->GetDuration()))),
+			_end(std::max(_start, std::min(end, source->GetDuration())))
+		{
+			_source->Retain();
+		}
+		
+		ClipRange::~ClipRange()
+		{
+			_source->Release();
+		}
+		
+		void ClipRange::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			_source->Sample(_start + WrapTime(time, GetDuration()), positions, rotations, scales);
+		}
+	}
+}
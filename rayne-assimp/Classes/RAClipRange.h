@@ -0,0 +1,58 @@
+//
+//  RAClipRange.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_CLIPRANGE__
+#define __RAYNE_ASSIMP_CLIPRANGE__
+
+#include <Rayne/Rayne.h>
+#include "RAClip.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Named time range of another clip. The range only references its source, so splitting a long take
+		// into moves neither copies nor resamples any keys. Ranges of streamed clips sample through the
+		// clip's one off window, playback needs its own StreamCursor::CreateForClip().
+		class ClipRange : public Clip
+		{
+		public:
+			// Start and end are in seconds and get clamped to the source
+			ClipRange(NameID name, Clip *source, float start, float end);
+			~ClipRange() override;
+			
+			Clip *GetSource() const { return _source; }
+			float GetStart() const { return _start; }
+			float GetEnd() const { return _end; }
+			
+			float GetDuration() const override { return _end - _start; }
+			size_t GetMemorySize() const override { return sizeof(ClipRange); }
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			void WaitUntilResident() const override { _source->WaitUntilResident(); }
+			
+		private:
+			Clip *_source;
+			float _start;
+			float _end;
+			
+			RNDeclareMeta(ClipRange)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_CLIPRANGE__ */
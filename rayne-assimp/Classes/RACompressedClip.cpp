@@ -0,0 +1,208 @@
+//
+//  RACompressedClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RACompressedClip.h"
+#include <algorithm>
+#include <cmath>
+
+#define kRARotationComponentRange 0.70710678f // The three smallest components of a unit quaternion are within +-1/sqrt(2)
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(CompressedClip, Clip)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: CompressedClip
+		// ---------------------
+		
+		CompressedClip::CompressedClip(NameID name, size_t boneCount, float duration, float sampleRate) :
+			Clip(name, boneCount),
+			_frameCount(CountFrames(duration, sampleRate)),
+			_sampleRate(sampleRate),
+			_duration(std::max(duration, 0.0f)),
+			_positions(boneCount),
+			_rotations(boneCount),
+			_scales(boneCount)
+		{}
+		
+		size_t CompressedClip::GetKeyCount() const
+		{
+			size_t count = 0;
+			
+			for(size_t i = 0; i < _boneCount; i ++)
+				count += _positions[i].frames.size() + _rotations[i].frames.size() + _scales[i].frames.size();
+			
+			return count;
+		}
+		
+		size_t CompressedClip::GetMemorySize() const
+		{
+			size_t size = 0;
+			
+			for(size_t i = 0; i < _boneCount; i ++)
+			{
+				const Track *tracks[3] = { &_positions[i], &_rotations[i], &_scales[i] };
+				for(const Track *track : tracks)
+					size += sizeof(Track) + (track->frames.size() + track->values.size()) * sizeof(uint16);
+			}
+			
+			return size;
+		}
+		
+		void CompressedClip::PackVector(const float *vector, const Track &track, uint16 *packed)
+		{
+			for(int i = 0; i < 3; i ++)
+			{
+				float normalized = (track.extent[i] > 0.0f) ? (vector[i] - track.minimum[i]) / track.extent[i] : 0.0f;
+				packed[i] = static_cast<uint16>(std::round(std::min(std::max(normalized, 0.0f), 1.0f) * 65535.0f));
+			}
+		}
+		
+		void CompressedClip::UnpackVector(const uint16 *packed, const Track &track, float *vector)
+		{
+			for(int i = 0; i < 3; i ++)
+				vector[i] = track.minimum[i] + (packed[i] / 65535.0f) * track.extent[i];
+		}
+		
+		void CompressedClip::PackRotation(const float *rotation, uint16 *packed)
+		{
+			int largest = 0;
+			for(int i = 1; i < 4; i ++)
+			{
+				if(std::fabs(rotation[i]) > std::fabs(rotation[largest]))
+					largest = i;
+			}
+			
+			// q and -q are the same rotation, flipping keeps the dropped component positive
+			float sign = (rotation[largest] < 0.0f) ? -1.0f : 1.0f;
+			uint64 bits = static_cast<uint64>(largest);
+			
+			for(int i = 0; i < 4; i ++)
+			{
+				if(i == largest)
+					continue;
+				
+				float normalized = (rotation[i] * sign / kRARotationComponentRange) * 0.5f + 0.5f;
+				uint64 component = static_cast<uint64>(std::round(std::min(std::max(normalized, 0.0f), 1.0f) * 32767.0f));
+				
+				bits = (bits << 15) | component;
+			}
+			
+			packed[0] = static_cast<uint16>(bits >> 32);
+			packed[1] = static_cast<uint16>(bits >> 16);
+			packed[2] = static_cast<uint16>(bits);
+		}
+		
+		void CompressedClip::UnpackRotation(const uint16 *packed, float *rotation)
+		{
+			uint64 bits = (static_cast<uint64>(packed[0]) << 32) | (static_cast<uint64>(packed[1]) << 16) | static_cast<uint64>(packed[2]);
+			
+			float components[3];
+			for(int i = 2; i >= 0; i --)
+			{
+				components[i] = ((bits & 0x7fff) / 32767.0f * 2.0f - 1.0f) * kRARotationComponentRange;
+				bits >>= 15;
+			}
+			
+			int largest = static_cast<int>(bits & 0x3);
+			float sum = 0.0f;
+			
+			for(int i = 0, j = 0; i < 4; i ++)
+			{
+				if(i == largest)
+					continue;
+				
+				rotation[i] = components[j ++];
+				sum += rotation[i] * rotation[i];
+			}
+			
+			rotation[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+		}
+		
+		void CompressedClip::SampleTrack(const Track &track, float frame, bool rotation, float *result)
+		{
+			auto next = std::upper_bound(track.frames.begin(), track.frames.end(), static_cast<uint16>(frame));
+			size_t key = (next == track.frames.begin()) ? 0 : std::distance(track.frames.begin(), next) - 1;
+			
+			if(rotation)
+				UnpackRotation(&track.values[key * 3], result);
+			else
+				UnpackVector(&track.values[key * 3], track, result);
+			
+			if(key + 1 >= track.frames.size())
+				return;
+			
+			float to[4];
+			float factor = (frame - track.frames[key]) / static_cast<float>(track.frames[key + 1] - track.frames[key]);
+			
+			if(rotation)
+			{
+				UnpackRotation(&track.values[(key + 1) * 3], to);
+				InterpolateRotation(result, to, factor, result);
+			}
+			else
+			{
+				UnpackVector(&track.values[(key + 1) * 3], track, to);
+				InterpolateVector(result, to, factor, result);
+			}
+		}
+		
+		void CompressedClip::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			float frame = GetFramePosition(WrapTime(time, _duration), _duration, _sampleRate, _frameCount);
+			
+			for(size_t bone = 0; bone < _boneCount; bone ++)
+			{
+				float position[3];
+				float rotation[4];
+				float scale[3];
+				
+				SampleTrack(_positions[bone], frame, false, position);
+				SampleTrack(_rotations[bone], frame, true, rotation);
+				SampleTrack(_scales[bone], frame, false, scale);
+				
+				positions[bone] = Vector3(position[0], position[1], position[2]);
+				rotations[bone] = Quaternion(rotation[0], rotation[1], rotation[2], rotation[3]);
+				scales[bone] = Vector3(scale[0], scale[1], scale[2]);
+			}
+		}
+		
+		AnimationClip *CompressedClip::Decode() const
+		{
+			AnimationClip *clip = new AnimationClip(_name, _boneCount, _duration, _sampleRate);
+			
+			for(size_t bone = 0; bone < _boneCount; bone ++)
+			{
+				float *positions = clip->GetPositions(bone);
+				float *rotations = clip->GetRotations(bone);
+				float *scales = clip->GetScales(bone);
+				
+				for(size_t frame = 0; frame < _frameCount; frame ++)
+				{
+					SampleTrack(_positions[bone], static_cast<float>(frame), false, positions + frame * 3);
+					SampleTrack(_rotations[bone], static_cast<float>(frame), true, rotations + frame * 4);
+					SampleTrack(_scales[bone], static_cast<float>(frame), false, scales + frame * 3);
+				}
+			}
+			
+			return clip;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+//
+//  RACompressedClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_COMPRESSEDCLIP__
+#define __RAYNE_ASSIMP_COMPRESSEDCLIP__
+
+#include <Rayne/Rayne.h>
+#include "RAAnimationClip.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Key reduced and quantized version of an AnimationClip. Every track keeps the frame indices of its
+		// remaining keys and three 16 bit values per key: positions and scales relative to the track range,
+		// rotations as smallest three (2 bit index and three 15 bit components).
+		class CompressedClip : public Clip
+		{
+		public:
+			struct Track
+			{
+				std::vector<uint16> frames;
+				std::vector<uint16> values;
+				float minimum[3];
+				float extent[3];
+			};
+			
+			// Uses the same frame grid as an AnimationClip of that duration and rate
+			CompressedClip(NameID name, size_t boneCount, float duration, float sampleRate);
+			
+			size_t GetFrameCount() const { return _frameCount; }
+			float GetSampleRate() const { return _sampleRate; }
+			float GetDuration() const override { return _duration; }
+			size_t GetKeyCount() const;
+			size_t GetMemorySize() const override;
+			
+			Track &GetPositionTrack(size_t bone) { return _positions[bone]; }
+			Track &GetRotationTrack(size_t bone) { return _rotations[bone]; }
+			Track &GetScaleTrack(size_t bone) { return _scales[bone]; }
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			AnimationClip *Decode() const;
+			
+			static void PackVector(const float *vector, const Track &track, uint16 *packed);
+			static void UnpackVector(const uint16 *packed, const Track &track, float *vector);
+			static void PackRotation(const float *rotation, uint16 *packed);
+			static void UnpackRotation(const uint16 *packed, float *rotation);
+			
+		private:
+			static void SampleTrack(const Track &track, float frame, bool rotation, float *result);
+			
+			size_t _frameCount;
+			float _sampleRate;
+			float _duration;
+			
+			std::vector<Track> _positions;
+			std::vector<Track> _rotations;
+			std::vector<Track> _scales;
+			
+			RNDeclareMeta(CompressedClip)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_COMPRESSEDCLIP__ */
@@ -0,0 +1,45 @@
+//
+//  RAHash.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_HASH__
+#define __RAYNE_ASSIMP_HASH__
+
+#include <Rayne/Rayne.h>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// 64 bit FNV-1a, used for cache keys and name lookups. Not cryptographic, chained calls continue a hash.
+		static const uint64 kHashSeed = 14695981039346656037ULL;
+		
+		inline uint64 HashBytes(const void *bytes, size_t length, uint64 hash = kHashSeed)
+		{
+			const uint8 *data = static_cast<const uint8 *>(bytes);
+			
+			for(size_t i = 0; i < length; i ++)
+			{
+				hash ^= data[i];
+				hash *= 1099511628211ULL;
+			}
+			
+			return hash;
+		}
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_HASH__ */
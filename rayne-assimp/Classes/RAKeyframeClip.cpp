@@ -0,0 +1,273 @@
+//
+//  RAKeyframeClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAKeyframeClip.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#define kRAKeyframeClipMagic   0x434b4152 // 'RAKC'
+#define kRAKeyframeClipVersion 1
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(KeyframeClip, Clip)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: KeyframeClip
+		// ---------------------
+		
+		KeyframeClip::KeyframeClip(NameID name, size_t boneCount, float duration) :
+			Clip(name, boneCount),
+			_duration(duration)
+		{
+			Channel empty = { 0, 0, 0 };
+			
+			_positions.resize(boneCount, empty);
+			_rotations.resize(boneCount, empty);
+			_scales.resize(boneCount, empty);
+		}
+		
+		size_t KeyframeClip::GetMemorySize() const
+		{
+			size_t channels = (_positions.size() + _rotations.size() + _scales.size()) * sizeof(Channel);
+			return channels + (_times.size() + _vectors.size() + _quaternions.size()) * sizeof(float);
+		}
+		
+		void KeyframeClip::AddKeys(Channel &channel, const float *times, const float *values, size_t count, std::vector<float> &storage, size_t components)
+		{
+			channel.timeOffset = static_cast<uint32>(_times.size());
+			channel.valueOffset = static_cast<uint32>(storage.size() / components);
+			channel.count = static_cast<uint32>(count);
+			
+			_times.insert(_times.end(), times, times + count);
+			storage.insert(storage.end(), values, values + count * components);
+		}
+		
+		void KeyframeClip::SetPositionKeys(size_t bone, const float *times, const float *values, size_t count)
+		{
+			AddKeys(_positions[bone], times, values, count, _vectors, 3);
+		}
+		
+		void KeyframeClip::SetRotationKeys(size_t bone, const float *times, const float *values, size_t count)
+		{
+			AddKeys(_rotations[bone], times, values, count, _quaternions, 4);
+		}
+		
+		void KeyframeClip::SetScaleKeys(size_t bone, const float *times, const float *values, size_t count)
+		{
+			AddKeys(_scales[bone], times, values, count, _vectors, 3);
+		}
+		
+		void KeyframeClip::SampleChannel(const Channel &channel, const std::vector<float> &storage, bool rotation, float time, float identity, float *result) const
+		{
+			size_t components = rotation ? 4 : 3;
+			
+			if(channel.count == 0)
+			{
+				for(size_t i = 0; i < components; i ++)
+					result[i] = rotation ? ((i == 3) ? 1.0f : 0.0f) : identity;
+				
+				return;
+			}
+			
+			const float *times = &_times[channel.timeOffset];
+			const float *values = &storage[channel.valueOffset * components];
+			
+			size_t key = std::distance(times, std::upper_bound(times, times + channel.count, time));
+			if(key == 0 || key == channel.count)
+			{
+				key = (key == 0) ? 0 : channel.count - 1;
+				std::copy(values + key * components, values + (key + 1) * components, result);
+				return;
+			}
+			
+			float factor = (time - times[key - 1]) / (times[key] - times[key - 1]);
+			
+			if(rotation)
+				SlerpRotation(values + (key - 1) * 4, values + key * 4, factor, result);
+			else
+				InterpolateVector(values + (key - 1) * 3, values + key * 3, factor, result);
+		}
+		
+		void KeyframeClip::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			SampleAt(WrapTime(time, _duration), positions, rotations, scales);
+		}
+		
+		void KeyframeClip::SampleAt(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			for(size_t bone = 0; bone < _boneCount; bone ++)
+			{
+				float position[3];
+				float rotation[4];
+				float scale[3];
+				
+				SampleChannel(_positions[bone], _vectors, false, time, 0.0f, position);
+				SampleChannel(_rotations[bone], _quaternions, true, time, 0.0f, rotation);
+				SampleChannel(_scales[bone], _vectors, false, time, 1.0f, scale);
+				
+				positions[bone] = Vector3(position[0], position[1], position[2]);
+				rotations[bone] = Quaternion(rotation[0], rotation[1], rotation[2], rotation[3]);
+				scales[bone] = Vector3(scale[0], scale[1], scale[2]);
+			}
+		}
+		
+		AnimationClip *KeyframeClip::Resample(float sampleRate) const
+		{
+			AnimationClip *clip = new AnimationClip(_name, _boneCount, _duration, sampleRate);
+			size_t frameCount = clip->GetFrameCount();
+			
+			std::vector<Vector3> positions(_boneCount);
+			std::vector<Quaternion> rotations(_boneCount);
+			std::vector<Vector3> scales(_boneCount);
+			
+			for(size_t frame = 0; frame < frameCount; frame ++)
+			{
+				// The last frame lands on the duration, wrapping would turn it into the first one
+				SampleAt(std::min(frame / sampleRate, _duration), positions.data(), rotations.data(), scales.data());
+				
+				for(size_t bone = 0; bone < _boneCount; bone ++)
+				{
+					float *position = clip->GetPositions(bone) + frame * 3;
+					float *rotation = clip->GetRotations(bone) + frame * 4;
+					float *scale = clip->GetScales(bone) + frame * 3;
+					
+					position[0] = positions[bone].x;
+					position[1] = positions[bone].y;
+					position[2] = positions[bone].z;
+					
+					rotation[0] = rotations[bone].x;
+					rotation[1] = rotations[bone].y;
+					rotation[2] = rotations[bone].z;
+					rotation[3] = rotations[bone].w;
+					
+					scale[0] = scales[bone].x;
+					scale[1] = scales[bone].y;
+					scale[2] = scales[bone].z;
+				}
+			}
+			
+			return clip;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Baked cache
+		// ---------------------
+		
+		template<class T>
+		static bool ReadVector(std::ifstream &stream, std::vector<T> &vector, size_t count)
+		{
+			vector.resize(count);
+			stream.read(reinterpret_cast<char *>(vector.data()), count * sizeof(T));
+			
+			return stream.good();
+		}
+		
+		template<class T>
+		static void WriteVector(std::ofstream &stream, const std::vector<T> &vector)
+		{
+			stream.write(reinterpret_cast<const char *>(vector.data()), vector.size() * sizeof(T));
+		}
+		
+		bool KeyframeClip::ReadFromFile(const std::string &path)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			if(!stream.is_open())
+				return false;
+			
+			uint32 header[6];
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			
+			if(!stream.good() || header[0] != kRAKeyframeClipMagic || header[1] != kRAKeyframeClipVersion || header[2] != _boneCount)
+				return false;
+			
+			std::vector<Channel> positions, rotations, scales;
+			std::vector<float> times, vectors, quaternions;
+			
+			if(!ReadVector(stream, positions, _boneCount) || !ReadVector(stream, rotations, _boneCount) || !ReadVector(stream, scales, _boneCount))
+				return false;
+			
+			if(!ReadVector(stream, times, header[3]) || !ReadVector(stream, vectors, header[4]) || !ReadVector(stream, quaternions, header[5]))
+				return false;
+			
+			_positions = std::move(positions);
+			_rotations = std::move(rotations);
+			_scales = std::move(scales);
+			
+			_times = std::move(times);
+			_vectors = std::move(vectors);
+			_quaternions = std::move(quaternions);
+			
+			return true;
+		}
+		
+		void KeyframeClip::WriteToFile(const std::string &path) const
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			uint32 header[6] = { kRAKeyframeClipMagic, kRAKeyframeClipVersion, static_cast<uint32>(_boneCount), static_cast<uint32>(_times.size()), static_cast<uint32>(_vectors.size()), static_cast<uint32>(_quaternions.size()) };
+			stream.write(reinterpret_cast<const char *>(header), sizeof(header));
+			
+			WriteVector(stream, _positions);
+			WriteVector(stream, _rotations);
+			WriteVector(stream, _scales);
+			
+			WriteVector(stream, _times);
+			WriteVector(stream, _vectors);
+			WriteVector(stream, _quaternions);
+			
+			stream.close();
+			
+			// Readers only ever see complete files, an interrupted write leaves the temporary behind
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				throw Exception(Exception::Type::GenericException, "Couldn't write animation clip " + path);
+			}
+			
+			std::remove(path.c_str());
+			if(std::rename(temporary.c_str(), path.c_str()) != 0)
+				throw Exception(Exception::Type::GenericException, "Couldn't write animation clip " + path);
+		}
+		
+		bool KeyframeClip::IsValidFile(const std::string &path, size_t boneCount)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+			if(!stream.is_open())
+				return false;
+			
+			size_t size = static_cast<size_t>(stream.tellg());
+			stream.seekg(0);
+			
+			uint32 header[6];
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			
+			if(!stream.good() || header[0] != kRAKeyframeClipMagic || header[1] != kRAKeyframeClipVersion || header[2] != boneCount)
+				return false;
+			
+			size_t expected = sizeof(header) + boneCount * 3 * sizeof(Channel) + (static_cast<size_t>(header[3]) + header[4] + header[5]) * sizeof(float);
+			return (size == expected);
+		}
+	}
+}
@@ -0,0 +1,84 @@
+//
+//  RAKeyframeClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_KEYFRAMECLIP__
+#define __RAYNE_ASSIMP_KEYFRAMECLIP__
+
+#include <Rayne/Rayne.h>
+#include "RAClip.h"
+#include "RAAnimationClip.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Keeps the source keys of every channel on their own timeline, a channel with a single constant
+		// key stores exactly one key no matter how dense the other channels of the bone are.
+		class KeyframeClip : public Clip
+		{
+		public:
+			KeyframeClip(NameID name, size_t boneCount, float duration);
+			
+			float GetDuration() const override { return _duration; }
+			size_t GetKeyCount() const { return _times.size(); }
+			size_t GetMemorySize() const override;
+			
+			// Times are in seconds and have to be ascending, values are xyz or xyzw for rotations
+			void SetPositionKeys(size_t bone, const float *times, const float *values, size_t count);
+			void SetRotationKeys(size_t bone, const float *times, const float *values, size_t count);
+			void SetScaleKeys(size_t bone, const float *times, const float *values, size_t count);
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			
+			// Returns a new clip holding the keys sampled at the given rate
+			AnimationClip *Resample(float sampleRate) const;
+			
+			// Baked cache, reading fails if the file is missing or doesn't match the bone count. Files are written
+			// to a temporary and renamed, IsValidFile() also catches files truncated by some other way.
+			bool ReadFromFile(const std::string &path);
+			void WriteToFile(const std::string &path) const;
+			
+			static bool IsValidFile(const std::string &path, size_t boneCount);
+			
+		private:
+			struct Channel
+			{
+				uint32 timeOffset;  // First key in _times
+				uint32 valueOffset; // First key in the value storage of the channel type
+				uint32 count;
+			};
+			
+			void AddKeys(Channel &channel, const float *times, const float *values, size_t count, std::vector<float> &storage, size_t components);
+			void SampleAt(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const;
+			void SampleChannel(const Channel &channel, const std::vector<float> &storage, bool rotation, float time, float identity, float *result) const;
+			
+			float _duration;
+			
+			std::vector<Channel> _positions;
+			std::vector<Channel> _rotations;
+			std::vector<Channel> _scales;
+			
+			std::vector<float> _times;
+			std::vector<float> _vectors;   // Position and scale values
+			std::vector<float> _quaternions;
+			
+			RNDeclareMeta(KeyframeClip)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_KEYFRAMECLIP__ */
@@ -0,0 +1,227 @@
+//
+//  RALazyClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RALazyClip.h"
+#include "RAKeyframeClip.h"
+#include <chrono>
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(LazyClip, Clip)
+		
+		static int64 GetTicks()
+		{
+			return static_cast<int64>(std::chrono::steady_clock::now().time_since_epoch().count());
+		}
+		
+		static Clip *DecodeClip(const std::string &path, NameID name, size_t boneCount, float duration, const LazyClip::Decoding &decoding, const SkeletonLayout *layout)
+		{
+			KeyframeClip *keys = new KeyframeClip(name, boneCount, duration);
+			
+			if(!keys->ReadFromFile(path))
+			{
+				keys->Release();
+				throw Exception(Exception::Type::GenericException, "Couldn't read animation clip " + path);
+			}
+			
+			if(decoding.sampleRate <= k::EpsilonFloat)
+				return keys;
+			
+			AnimationClip *clip = keys->Resample(decoding.sampleRate);
+			keys->Release();
+			
+			if(decoding.compress)
+			{
+				CompressedClip *compressed = AnimationCompressor(layout, decoding.compression).Compress(clip);
+				if(compressed)
+				{
+					clip->Release();
+					return compressed;
+				}
+			}
+			
+			return clip;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: LazyClip
+		// ---------------------
+		
+		LazyClip::LazyClip(NameID name, size_t boneCount, float duration, size_t channelCount, const std::string &path, const Decoding &decoding, const SkeletonLayout *layout) :
+			Clip(name, boneCount),
+			_duration(duration),
+			_channelCount(channelCount),
+			_path(path),
+			_decoding(decoding),
+			_layout(layout),
+			_resident(nullptr),
+			_lastUse(0)
+		{}
+		
+		LazyClip::~LazyClip()
+		{
+			if(_pending.valid())
+			{
+				try
+				{
+					_pending.get()->Release();
+				}
+				catch(Exception e)
+				{}
+			}
+			
+			if(_resident)
+				_resident->Release();
+		}
+		
+		size_t LazyClip::GetMemorySize() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return sizeof(LazyClip) + _path.capacity() + (_resident ? _resident->GetMemorySize() : 0);
+		}
+		
+		bool LazyClip::IsResident() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return (_resident != nullptr);
+		}
+		
+		void LazyClip::Prefetch() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_lastUse = GetTicks();
+			
+			if(!_resident && !_pending.valid())
+				StartDecoding();
+		}
+		
+		bool LazyClip::Evict(float unusedSeconds)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			AdoptDecoded();
+			
+			if(!_resident)
+				return false;
+			
+			std::chrono::steady_clock::duration unused(GetTicks() - _lastUse);
+			if(std::chrono::duration<float>(unused).count() < unusedSeconds)
+				return false;
+			
+			_resident->Release();
+			_resident = nullptr;
+			
+			return true;
+		}
+		
+		void LazyClip::StartDecoding() const
+		{
+			std::string path = _path;
+			NameID name = _name;
+			size_t boneCount = _boneCount;
+			float duration = _duration;
+			Decoding decoding = _decoding;
+			const SkeletonLayout *layout = _layout;
+			
+			_pending = ThreadPool::GetSharedInstance()->AddTask([=]() -> Clip * {
+				return DecodeClip(path, name, boneCount, duration, decoding, layout);
+			}).share();
+		}
+		
+		void LazyClip::AdoptDecoded() const
+		{
+			if(_resident || !_pending.valid() || _pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return;
+			
+			// Reset the future first, a failed decode is retried by the next use instead of rethrowing forever
+			std::shared_future<Clip *> pending = std::move(_pending);
+			_pending = std::shared_future<Clip *>();
+			
+			_resident = pending.get();
+		}
+		
+		Clip *LazyClip::Acquire() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			_lastUse = GetTicks();
+			AdoptDecoded();
+			
+			if(!_resident)
+			{
+				if(!_pending.valid())
+					StartDecoding();
+				
+				return nullptr;
+			}
+			
+			_resident->Retain();
+			return _resident;
+		}
+		
+		void LazyClip::WaitUntilResident() const
+		{
+			while(1)
+			{
+				std::shared_future<Clip *> pending;
+				
+				{
+					std::lock_guard<std::mutex> lock(_lock);
+					
+					_lastUse = GetTicks();
+					AdoptDecoded();
+					
+					if(_resident)
+						return;
+					
+					if(!_pending.valid())
+						StartDecoding();
+					
+					pending = _pending;
+				}
+				
+				pending.wait();
+			}
+		}
+		
+		void LazyClip::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			Clip *clip;
+			
+			// Sampling runs in the animation update, a broken cache file only costs this clip its motion
+			try
+			{
+				clip = Acquire();
+			}
+			catch(Exception e)
+			{
+				RNWarning("Couldn't decode animation clip " << _path);
+				return;
+			}
+			
+			if(!clip)
+				return;
+			
+			clip->Sample(time, positions, rotations, scales);
+			clip->Release();
+		}
+	}
+}
@@ -0,0 +1,89 @@
+//
+//  RALazyClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_LAZYCLIP__
+#define __RAYNE_ASSIMP_LAZYCLIP__
+
+#include <Rayne/Rayne.h>
+#include "RAClip.h"
+#include "RAAnimationCompressor.h"
+#include <atomic>
+#include <future>
+#include <mutex>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Clip metadata whose keys stay in the baked cache until the clip is used. The keys are
+		// converted on the thread pool, started by Prefetch() or the first Sample(), and dropped
+		// again by Evict() once the clip goes unused. Sample() never waits for the keys, until they
+		// arrive it leaves the output untouched so the caller keeps its bind or previous pose.
+		class LazyClip : public Clip
+		{
+		public:
+			struct Decoding
+			{
+				Decoding() :
+					sampleRate(0.0f),
+					compress(false)
+				{}
+				
+				float sampleRate; // 0 keeps the keys on their own timelines
+				bool compress;
+				AnimationCompressor::Settings compression;
+			};
+			
+			// The layout is only used for compression and has to outlive the clip, it usually owns it
+			LazyClip(NameID name, size_t boneCount, float duration, size_t channelCount, const std::string &path, const Decoding &decoding, const SkeletonLayout *layout);
+			~LazyClip() override;
+			
+			float GetDuration() const override { return _duration; }
+			size_t GetChannelCount() const { return _channelCount; }
+			size_t GetMemorySize() const override;
+			
+			bool IsResident() const;
+			void Prefetch() const;
+			
+			// Drops the decoded keys if the clip wasn't sampled for the given time, returns true if it did
+			bool Evict(float unusedSeconds);
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			void WaitUntilResident() const override;
+			
+		private:
+			Clip *Acquire() const;
+			void StartDecoding() const;
+			void AdoptDecoded() const;
+			
+			float _duration;
+			size_t _channelCount;
+			std::string _path;
+			Decoding _decoding;
+			const SkeletonLayout *_layout;
+			
+			mutable std::mutex _lock;
+			mutable Clip *_resident;
+			mutable std::shared_future<Clip *> _pending;
+			mutable std::atomic<int64> _lastUse; // steady_clock ticks
+			
+			RNDeclareMeta(LazyClip)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_LAZYCLIP__ */
@@ -0,0 +1,87 @@
+//
+//  RANameTable.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RANameTable.h"
+#include "RAHash.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: NameTable
+		// ---------------------
+		
+		NameTable::NameTable()
+		{}
+		
+		NameTable *NameTable::GetSharedInstance()
+		{
+			static NameTable *instance = new NameTable();
+			return instance;
+		}
+		
+		NameID NameTable::FindIDWithHash(const char *name, size_t length, uint64 hash) const
+		{
+			auto range = _lookup.equal_range(hash);
+			for(auto iterator = range.first; iterator != range.second; iterator ++)
+			{
+				const std::string &candidate = _names[iterator->second];
+				if(candidate.length() == length && candidate.compare(0, length, name, length) == 0)
+					return iterator->second;
+			}
+			
+			return InvalidID;
+		}
+		
+		NameID NameTable::GetID(const char *name, size_t length)
+		{
+			uint64 hash = HashBytes(name, length);
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			NameID id = FindIDWithHash(name, length, hash);
+			if(id == InvalidID)
+			{
+				id = static_cast<NameID>(_names.size());
+				
+				_names.emplace_back(name, length);
+				_lookup.insert(std::make_pair(hash, id));
+			}
+			
+			return id;
+		}
+		
+		NameID NameTable::FindID(const char *name, size_t length)
+		{
+			uint64 hash = HashBytes(name, length);
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			return FindIDWithHash(name, length, hash);
+		}
+		
+		const std::string &NameTable::GetName(NameID id)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(id >= _names.size())
+				throw Exception(Exception::Type::InvalidArgumentException, "Invalid name ID");
+			
+			return _names[id];
+		}
+	}
+}
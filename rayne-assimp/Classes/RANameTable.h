@@ -0,0 +1,61 @@
+//
+//  RANameTable.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_NAMETABLE__
+#define __RAYNE_ASSIMP_NAMETABLE__
+
+#include <Rayne/Rayne.h>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+
+namespace RN
+{
+	namespace assimp
+	{
+		typedef uint32 NameID;
+		
+		// Process wide string interning, equal names always map to the same ID so lookups by name
+		// turn into integer compares. IDs stay valid for the lifetime of the process.
+		class NameTable
+		{
+		public:
+			static const NameID InvalidID = 0xffffffff;
+			
+			static NameTable *GetSharedInstance();
+			
+			NameID GetID(const char *name, size_t length);
+			NameID GetID(const std::string &name) { return GetID(name.data(), name.length()); }
+			
+			NameID FindID(const char *name, size_t length);
+			NameID FindID(const std::string &name) { return FindID(name.data(), name.length()); }
+			
+			const std::string &GetName(NameID id);
+			
+		private:
+			NameTable();
+			
+			NameID FindIDWithHash(const char *name, size_t length, uint64 hash) const;
+			
+			std::mutex _lock;
+			std::deque<std::string> _names;
+			std::unordered_multimap<uint64, NameID> _lookup;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_NAMETABLE__ */
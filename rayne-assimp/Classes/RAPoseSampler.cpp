@@ -0,0 +1,234 @@
+//
+//  RAPoseSampler.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAPoseSampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if RA_POSE_SAMPLER_SSE
+	#include <emmintrin.h>
+#endif
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: PoseSampler
+		// ---------------------
+		
+		PoseSampler::PoseSampler(const AnimationClip *clip) :
+			_boneCount(clip->GetBoneCount()),
+			_blockCount((clip->GetBoneCount() + BlockWidth - 1) / BlockWidth),
+			_frameCount(clip->GetFrameCount()),
+			_sampleRate(clip->GetSampleRate()),
+			_duration(clip->GetDuration())
+		{
+			// Padding lanes hold the identity transform
+			static const float identity[BlockChannels] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+			
+			_data.resize(_frameCount * _blockCount * BlockSize);
+			
+			for(size_t frame = 0; frame < _frameCount; frame ++)
+			{
+				for(size_t block = 0; block < _blockCount; block ++)
+				{
+					float *target = &_data[(frame * _blockCount + block) * BlockSize];
+					
+					for(size_t lane = 0; lane < BlockWidth; lane ++)
+					{
+						size_t bone = block * BlockWidth + lane;
+						
+						if(bone >= _boneCount)
+						{
+							for(size_t channel = 0; channel < BlockChannels; channel ++)
+								target[channel * BlockWidth + lane] = identity[channel];
+							
+							continue;
+						}
+						
+						const float *position = clip->GetPositions(bone) + frame * 3;
+						const float *rotation = clip->GetRotations(bone) + frame * 4;
+						const float *scale = clip->GetScales(bone) + frame * 3;
+						
+						for(size_t i = 0; i < 3; i ++)
+							target[i * BlockWidth + lane] = position[i];
+						for(size_t i = 0; i < 4; i ++)
+							target[(3 + i) * BlockWidth + lane] = rotation[i];
+						for(size_t i = 0; i < 3; i ++)
+							target[(7 + i) * BlockWidth + lane] = scale[i];
+					}
+				}
+			}
+		}
+		
+		void PoseSampler::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			if(_frameCount == 0)
+				return;
+			
+			if(_duration > 0.0f)
+			{
+				time = std::fmod(time, _duration);
+				if(time < 0.0f)
+					time += _duration;
+			}
+			else
+			{
+				time = 0.0f;
+			}
+			
+			float position = Clip::GetFramePosition(time, _duration, _sampleRate, _frameCount);
+			size_t frame = std::min(static_cast<size_t>(position), _frameCount - 1);
+			size_t next = std::min(frame + 1, _frameCount - 1);
+			float factor = position - frame;
+			
+			const float *from = &_data[frame * _blockCount * BlockSize];
+			const float *to = &_data[next * _blockCount * BlockSize];
+			
+			float result[BlockSize];
+			
+#if RA_POSE_SAMPLER_SSE
+			const __m128 t = _mm_set1_ps(factor);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 signbit = _mm_set1_ps(-0.0f);
+#endif
+			
+			for(size_t block = 0; block < _blockCount; block ++)
+			{
+				const float *a = from + block * BlockSize;
+				const float *b = to + block * BlockSize;
+				
+#if RA_POSE_SAMPLER_SSE
+				// Positions and scales
+				for(size_t channel = 0; channel < BlockChannels; channel ++)
+				{
+					if(channel >= 3 && channel < 7)
+						continue;
+					
+					__m128 va = _mm_loadu_ps(a + channel * BlockWidth);
+					__m128 vb = _mm_loadu_ps(b + channel * BlockWidth);
+					_mm_storeu_ps(result + channel * BlockWidth, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), t)));
+				}
+				
+				// Rotations, nlerp along the shorter arc
+				__m128 ax = _mm_loadu_ps(a + 3 * BlockWidth);
+				__m128 ay = _mm_loadu_ps(a + 4 * BlockWidth);
+				__m128 az = _mm_loadu_ps(a + 5 * BlockWidth);
+				__m128 aw = _mm_loadu_ps(a + 6 * BlockWidth);
+				__m128 bx = _mm_loadu_ps(b + 3 * BlockWidth);
+				__m128 by = _mm_loadu_ps(b + 4 * BlockWidth);
+				__m128 bz = _mm_loadu_ps(b + 5 * BlockWidth);
+				__m128 bw = _mm_loadu_ps(b + 6 * BlockWidth);
+				
+				__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+				__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), signbit);
+				
+				bx = _mm_xor_ps(bx, flip);
+				by = _mm_xor_ps(by, flip);
+				bz = _mm_xor_ps(bz, flip);
+				bw = _mm_xor_ps(bw, flip);
+				
+				__m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+				__m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+				__m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+				__m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+				
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw))));
+				
+				_mm_storeu_ps(result + 3 * BlockWidth, _mm_div_ps(rx, length));
+				_mm_storeu_ps(result + 4 * BlockWidth, _mm_div_ps(ry, length));
+				_mm_storeu_ps(result + 5 * BlockWidth, _mm_div_ps(rz, length));
+				_mm_storeu_ps(result + 6 * BlockWidth, _mm_div_ps(rw, length));
+#else
+				for(size_t lane = 0; lane < BlockWidth; lane ++)
+				{
+					for(size_t channel = 0; channel < BlockChannels; channel ++)
+					{
+						if(channel >= 3 && channel < 7)
+							continue;
+						
+						size_t i = channel * BlockWidth + lane;
+						result[i] = a[i] + (b[i] - a[i]) * factor;
+					}
+					
+					float dot = 0.0f;
+					for(size_t i = 3; i < 7; i ++)
+						dot += a[i * BlockWidth + lane] * b[i * BlockWidth + lane];
+					
+					float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+					float length = 0.0f;
+					
+					for(size_t i = 3; i < 7; i ++)
+					{
+						size_t index = i * BlockWidth + lane;
+						result[index] = a[index] + (b[index] * sign - a[index]) * factor;
+						length += result[index] * result[index];
+					}
+					
+					length = std::sqrt(length);
+					for(size_t i = 3; i < 7; i ++)
+						result[i * BlockWidth + lane] /= length;
+				}
+#endif
+				
+				size_t count = std::min<size_t>(BlockWidth, _boneCount - block * BlockWidth);
+				for(size_t lane = 0; lane < count; lane ++)
+				{
+					size_t bone = block * BlockWidth + lane;
+					
+					positions[bone] = Vector3(result[0 * BlockWidth + lane], result[1 * BlockWidth + lane], result[2 * BlockWidth + lane]);
+					rotations[bone] = Quaternion(result[3 * BlockWidth + lane], result[4 * BlockWidth + lane], result[5 * BlockWidth + lane], result[6 * BlockWidth + lane]);
+					scales[bone] = Vector3(result[7 * BlockWidth + lane], result[8 * BlockWidth + lane], result[9 * BlockWidth + lane]);
+				}
+			}
+		}
+		
+		double PoseSampler::MeasureThroughput(double seconds) const
+		{
+			std::vector<Vector3> positions(_boneCount);
+			std::vector<Quaternion> rotations(_boneCount);
+			std::vector<Vector3> scales(_boneCount);
+			
+			typedef std::chrono::steady_clock Clock;
+			
+			Clock::time_point start = Clock::now();
+			double elapsed = 0.0;
+			size_t samples = 0;
+			
+			// The step isn't a multiple of the frame time, so the samples land between frames like they would at runtime
+			float time = 0.0f;
+			float step = (_duration > 0.0f) ? _duration * 0.0137f : 0.0f;
+			
+			while(elapsed < seconds)
+			{
+				for(size_t i = 0; i < 64; i ++)
+				{
+					Sample(time, positions.data(), rotations.data(), scales.data());
+					time += step;
+				}
+				
+				samples += 64;
+				elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			}
+			
+			return (samples * _boneCount) / (elapsed * 1000000.0);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+//
+//  RAPoseSampler.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_POSESAMPLER__
+#define __RAYNE_ASSIMP_POSESAMPLER__
+
+#include <Rayne/Rayne.h>
+#include "RAAnimationClip.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define RA_POSE_SAMPLER_SSE 1
+#else
+	#define RA_POSE_SAMPLER_SSE 0
+#endif
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Evaluates four bones per step. The clip is transposed into frame major blocks of four bones with
+		// every channel component in its own lane array, so one unaligned load fetches the same value for
+		// four bones. Frames of a fixed rate clip are found by multiplication, there is no key search left.
+		class PoseSampler
+		{
+		public:
+			PoseSampler(const AnimationClip *clip);
+			
+			size_t GetBoneCount() const { return _boneCount; }
+			float GetDuration() const { return _duration; }
+			
+			// Time is in seconds and wraps around the duration
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const;
+			
+			// Samples the clip at spread out times for the given duration and returns the bones evaluated per microsecond
+			double MeasureThroughput(double seconds) const;
+			
+		private:
+			enum
+			{
+				BlockWidth = 4,
+				BlockChannels = 10, // Position xyz, rotation xyzw, scale xyz
+				BlockSize = BlockWidth * BlockChannels
+			};
+			
+			size_t _boneCount;
+			size_t _blockCount;
+			size_t _frameCount;
+			float _sampleRate;
+			float _duration;
+			
+			std::vector<float> _data;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_POSESAMPLER__ */
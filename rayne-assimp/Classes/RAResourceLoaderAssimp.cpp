@@ -16,7 +16,25 @@
 //
 
 #include "RAResourceLoaderAssimp.h"
+#include "RAHash.h"
+#include "RATextureCache.h"
+#include "RATextureAtlas.h"
+#include "RATextureResidency.h"
+#include "RAShaderManifest.h"
+#include "RASceneIndex.h"
+#include "RASkeletonLayout.h"
+#include "RARigCache.h"
+#include "RAAnimationClip.h"
 #include <limits>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#define kRAClipBoundsMagic   0x42434152 // 'RACB'
+#define kRAClipBoundsVersion 1
 
 namespace RN
 {
@@ -29,6 +47,43 @@ namespace RN
 		// MARK: AssimpResourceLoader
 		// ---------------------
 		
+		AssimpResourceLoader::LoadStatistics::LoadStatistics() :
+			textureCount(0),
+			embeddedTextureCount(0),
+			atlasPageCount(0),
+			atlasedMeshCount(0),
+			biasedTextureCount(0),
+			deferredTextureCount(0),
+			preprocessedTextureCount(0),
+			boneCount(0),
+			meshBoneCount(0),
+			sceneNodeCount(0),
+			unmatchedBoneCount(0),
+			duplicateAnimationCount(0),
+			sharedSkeletonCount(0),
+			skeletonTime(0.0),
+			keyframeCount(0),
+			clipCount(0),
+			clipBytes(0),
+			animationTime(0.0),
+			compressedClipCount(0),
+			compressedClipBytes(0),
+			compressedKeyCount(0),
+			channelKeyCount(0),
+			lazyClipCount(0),
+			bakedClipCount(0),
+			rangeClipCount(0),
+			streamedClipCount(0),
+			paletteCount(0),
+			paletteBytes(0),
+			variantClipCount(0),
+			variantClipBytes(0),
+			maskedBoneCount(0),
+			boundedBoneCount(0),
+			clipBoundsCount(0),
+			newShaderPermutationCount(0)
+		{}
+		
 		AssimpResourceLoader::AssimpResourceLoader() :
 			ResourceLoader(Model::GetMetaClass())
 		{
@@ -59,20 +114,83 @@ namespace RN
 			}
 		}
 		
-		Asset *AssimpResourceLoader::Load(File *file, Dictionary *settings)
+		void AssimpResourceLoader::ReadAnimationRanges(const std::string &path, std::vector<AnimationRange> &ranges)
 		{
-			Model *model = new Model();
+			std::ifstream stream(path);
+			std::string line;
+			std::string animation;
 			
-			bool guessMaterial = true;
+			// A [take] line selects the source animation, the following "start end name" lines are ranges in seconds
+			while(std::getline(stream, line))
+			{
+				if(!line.empty() && line[line.length() - 1] == '\r')
+					line.erase(line.length() - 1);
+				
+				if(line.empty() || line[0] == '#')
+					continue;
+				
+				if(line[0] == '[')
+				{
+					animation = line.substr(1, line.find(']') - 1);
+					continue;
+				}
+				
+				std::stringstream components(line);
+				AnimationRange range;
+				range.animation = animation;
+				
+				// The sidecar is optional, a broken line only costs its own range
+				if(!(components >> range.start >> range.end) || !std::getline(components >> std::ws, range.name) || range.name.empty())
+				{
+					RNWarning("Skipping malformed animation range in " << path << ": " << line);
+					continue;
+				}
+				
+				ranges.push_back(range);
+			}
+		}
+		
+		Asset *AssimpResourceLoader::Load(File *file, Dictionary *settings)
+		{
 			bool recalculateNormals = false;
 			float smoothNormalAngle = 20.0f;
 			bool autoloadLOD = false;
 			size_t stage = 0;
 			
+			LoadContext context;
+			context.filepath = file->GetPath();
+			context.cachepath = PathManager::Join(file->GetPath(), "assimp-cache");
+			context.sourcepath = file->GetFullPath();
+			context.sourceHash = 0;
+			context.guessMaterial = true;
+			context.atlasTextures = false;
+			context.atlasMaxTextureSize = 256;
+			context.atlasPageSize = 2048;
+			context.lodMipBias = false;
+			context.mipBias = 0;
+			context.deferTextures = false;
+			context.preprocessTextures = false;
+			context.animationKeyframes = true;
+			context.animationChannels = false;
+			context.animationSampleRate = 0.0f;
+			context.lazyAnimations = false;
+			context.shareSkeletons = false;
+			context.streamDuration = 0.0f;
+			context.streamBlockDuration = 2.0f;
+			context.streamWindowBlocks = 3;
+			context.paletteSampleRate = 30.0f;
+			context.paletteHalfFloat = false;
+			context.skeletonLOD = false;
+			context.skeletonLODWeight = 0.0f;
+			context.skinnedBounds = false;
+			context.skinnedBoundsWeight = 0.0f;
+			context.skinnedBoundsRate = 30.0f;
+			context.compressAnimations = false;
+			
 			if(settings->GetObjectForKey(RNCSTR("guessMaterial")))
 			{
 				Number *number = settings->GetObjectForKey<Number>(RNCSTR("guessMaterial"));
-				guessMaterial = number->GetBoolValue();
+				context.guessMaterial = number->GetBoolValue();
 			}
 			
 			if(settings->GetObjectForKey(RNCSTR("recalculateNormals")))
@@ -93,6 +211,222 @@ namespace RN
 				autoloadLOD = number->GetBoolValue();
 			}
 			
+			if(settings->GetObjectForKey(RNCSTR("atlasTextures")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("atlasTextures"));
+				context.atlasTextures = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("atlasMaxTextureSize")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("atlasMaxTextureSize"));
+				context.atlasMaxTextureSize = number->GetUint32Value();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("atlasPageSize")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("atlasPageSize"));
+				context.atlasPageSize = number->GetUint32Value();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("lodMipBias")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("lodMipBias"));
+				context.lodMipBias = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("deferTextures")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("deferTextures"));
+				context.deferTextures = number->GetBoolValue();
+			}
+			
+			// The biased copies only save memory if the near stages don't pull in the full resolution sources
+			// during the load, so the bias implies deferred residency
+			if(context.lodMipBias)
+				context.deferTextures = true;
+			
+			if(settings->GetObjectForKey(RNCSTR("preprocessTextures")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("preprocessTextures"));
+				context.preprocessTextures = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationKeyframes")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("animationKeyframes"));
+				context.animationKeyframes = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationChannels")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("animationChannels"));
+				context.animationChannels = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationSampleRate")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("animationSampleRate"));
+				context.animationSampleRate = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("lazyAnimations")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("lazyAnimations"));
+				context.lazyAnimations = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("shareSkeletons")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("shareSkeletons"));
+				context.shareSkeletons = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("compressAnimations")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("compressAnimations"));
+				context.compressAnimations = number->GetBoolValue();
+				
+				// Compression works on resampled clips
+				if(context.compressAnimations && context.animationSampleRate <= k::EpsilonFloat)
+					context.animationSampleRate = 30.0f;
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skeletonLOD")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skeletonLOD"));
+				context.skeletonLOD = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skeletonLODWeight")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skeletonLODWeight"));
+				context.skeletonLODWeight = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinnedBounds")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skinnedBounds"));
+				context.skinnedBounds = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinnedBoundsWeight")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skinnedBoundsWeight"));
+				context.skinnedBoundsWeight = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinnedBoundsRate")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skinnedBoundsRate"));
+				context.skinnedBoundsRate = std::max(number->GetFloatValue(), 1.0f);
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationLODRates")))
+			{
+				Array *rates = settings->GetObjectForKey<Array>(RNCSTR("animationLODRates"));
+				rates->Enumerate<Number>([&](Number *number, size_t index, bool &stop) {
+					context.animationLODRates.push_back(number->GetFloatValue());
+				});
+				
+				// Variants are derived from the resampled full rate clip
+				if(!context.animationLODRates.empty() && context.animationSampleRate <= k::EpsilonFloat)
+					context.animationSampleRate = 30.0f;
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("streamAnimationDuration")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("streamAnimationDuration"));
+				context.streamDuration = number->GetFloatValue();
+				
+				// Streamed clips are stored at a fixed rate
+				if(context.streamDuration > k::EpsilonFloat && context.animationSampleRate <= k::EpsilonFloat)
+					context.animationSampleRate = 30.0f;
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("streamBlockDuration")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("streamBlockDuration"));
+				context.streamBlockDuration = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("streamWindowBlocks")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("streamWindowBlocks"));
+				context.streamWindowBlocks = number->GetUint32Value();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinningPalettes")))
+			{
+				Array *animations = settings->GetObjectForKey<Array>(RNCSTR("skinningPalettes"));
+				animations->Enumerate<String>([&](String *string, size_t index, bool &stop) {
+					context.paletteAnimations.insert(string->GetUTF8String());
+				});
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinningPaletteRate")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skinningPaletteRate"));
+				context.paletteSampleRate = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("skinningPaletteHalfFloat")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("skinningPaletteHalfFloat"));
+				context.paletteHalfFloat = number->GetBoolValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationPositionError")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("animationPositionError"));
+				context.compression.positionError = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationVertexDistance")))
+			{
+				Number *number = settings->GetObjectForKey<Number>(RNCSTR("animationVertexDistance"));
+				context.compression.vertexDistance = number->GetFloatValue();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("cachePath")))
+			{
+				String *string = settings->GetObjectForKey<String>(RNCSTR("cachePath"));
+				context.cachepath = string->GetUTF8String();
+			}
+			
+			if(settings->GetObjectForKey(RNCSTR("animationRanges")))
+			{
+				Array *ranges = settings->GetObjectForKey<Array>(RNCSTR("animationRanges"));
+				ranges->Enumerate<Dictionary>([&](Dictionary *dictionary, size_t index, bool &stop) {
+					AnimationRange range;
+					range.animation = dictionary->GetObjectForKey<String>(RNCSTR("animation"))->GetUTF8String();
+					range.name = dictionary->GetObjectForKey<String>(RNCSTR("name"))->GetUTF8String();
+					range.start = dictionary->GetObjectForKey<Number>(RNCSTR("start"))->GetFloatValue();
+					range.end = dictionary->GetObjectForKey<Number>(RNCSTR("end"))->GetFloatValue();
+					
+					context.animationRanges.push_back(range);
+				});
+			}
+			
+			ReadAnimationRanges(PathManager::Join(PathManager::Basepath(file->GetFullPath()), PathManager::Basename(file->GetFullPath()) + ".clips"), context.animationRanges);
+			
+			if(settings->GetObjectForKey(RNCSTR("skeleton")))
+			{
+				Skeleton *skeleton = settings->GetObjectForKey<Skeleton>(RNCSTR("skeleton"));
+				LoadAnimationLibrary(file, skeleton, context);
+				
+				if(settings->GetObjectForKey(RNCSTR("statistics")))
+				{
+					Dictionary *dictionary = settings->GetObjectForKey<Dictionary>(RNCSTR("statistics"));
+					WriteStatistics(context.statistics, dictionary);
+				}
+				
+				skeleton->Retain();
+				return skeleton;
+			}
+			
+			Model *model = new Model();
+			
 			Assimp::Importer importer;
 			importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, smoothNormalAngle);
 			
@@ -107,10 +441,13 @@ namespace RN
 			if(!scene)
 				throw Exception(Exception::Type::GenericException, importer.GetErrorString());
 			
-			LoadLODStage(scene, model, stage, file->GetPath(), guessMaterial);
+			SceneIndex index(scene);
+			
+			MapBones(scene, index, context);
+			LoadLODStage(scene, model, stage, context);
 			
 			if(scene->mNumAnimations > 0)
-				LoadSkeleton(scene, model);
+				LoadSkeleton(scene, index, model, context);
 			
 			std::string base = PathManager::Basepath(file->GetFullPath());
 			std::string name = PathManager::Basename(file->GetFullPath());
@@ -139,7 +476,11 @@ namespace RN
 						throw Exception(Exception::Type::GenericException, importer.GetErrorString());
 					
 					stage = model->AddLODStage(lodFactors[stage]);
-					LoadLODStage(scene, model, stage, lodPath, guessMaterial);
+					
+					context.filepath = PathManager::Basepath(lodPath);
+					context.mipBias = context.lodMipBias ? GetMipBias(lodFactors, stage) : 0;
+					
+					LoadLODStage(scene, model, stage, context);
 				}
 				catch(Exception e)
 				{
@@ -147,287 +488,772 @@ namespace RN
 				}
 			}
 			
+			if(!context.boneMasks.empty() && model->GetSkeleton())
+			{
+				SkeletonLayout *layout = SkeletonLayout::GetLayoutForSkeleton(model->GetSkeleton());
+				
+				for(size_t i = 0; i < context.boneMasks.size(); i++)
+				{
+					if(context.boneMasks[i].empty())
+						continue;
+					
+					layout->AddBoneMask(i, context.boneMasks[i]);
+					context.statistics.maskedBoneCount += std::count(context.boneMasks[i].begin(), context.boneMasks[i].end(), false);
+				}
+			}
+			
+			if(context.deferTextures)
+				TextureResidency::GetSharedInstance()->AddModel(model);
+			
+			// The model itself loaded fine, a manifest that can't be written only costs the pre-warming
+			if(context.statistics.newShaderPermutationCount > 0 && !ShaderManifest::GetSharedInstance()->Save())
+				RNWarning("Couldn't write the shader manifest");
+			
+			if(settings->GetObjectForKey(RNCSTR("statistics")))
+			{
+				Dictionary *dictionary = settings->GetObjectForKey<Dictionary>(RNCSTR("statistics"));
+				WriteStatistics(context.statistics, dictionary);
+			}
+			
 			return model;
 		}
 		
-		Texture *AssimpResourceLoader::GetTexture(aiMaterial *aimaterial, const std::string &filepath, aiTextureType aitexturetype, uint8 index)
+		void AssimpResourceLoader::WriteStatistics(const LoadStatistics &statistics, Dictionary *dictionary)
+		{
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.textureCount)), RNCSTR("textureCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.embeddedTextureCount)), RNCSTR("embeddedTextureCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.atlasPageCount)), RNCSTR("atlasPageCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.atlasedMeshCount)), RNCSTR("atlasedMeshCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.biasedTextureCount)), RNCSTR("biasedTextureCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.deferredTextureCount)), RNCSTR("deferredTextureCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.preprocessedTextureCount)), RNCSTR("preprocessedTextureCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.boneCount)), RNCSTR("boneCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.meshBoneCount)), RNCSTR("meshBoneCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.sceneNodeCount)), RNCSTR("sceneNodeCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.unmatchedBoneCount)), RNCSTR("unmatchedBoneCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.duplicateAnimationCount)), RNCSTR("duplicateAnimationCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.sharedSkeletonCount)), RNCSTR("sharedSkeletonCount"));
+			dictionary->SetObjectForKey(Number::WithDouble(statistics.skeletonTime), RNCSTR("skeletonTime"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.keyframeCount)), RNCSTR("keyframeCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.keyframeCount * sizeof(AnimationBone))), RNCSTR("keyframeBytes"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.clipCount)), RNCSTR("clipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.clipBytes)), RNCSTR("clipBytes"));
+			dictionary->SetObjectForKey(Number::WithDouble(statistics.animationTime), RNCSTR("animationTime"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.compressedClipCount)), RNCSTR("compressedClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.compressedClipBytes)), RNCSTR("compressedClipBytes"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.compressedKeyCount)), RNCSTR("compressedKeyCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.channelKeyCount)), RNCSTR("channelKeyCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.lazyClipCount)), RNCSTR("lazyClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.bakedClipCount)), RNCSTR("bakedClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.rangeClipCount)), RNCSTR("rangeClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.streamedClipCount)), RNCSTR("streamedClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.paletteCount)), RNCSTR("paletteCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.paletteBytes)), RNCSTR("paletteBytes"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.variantClipCount)), RNCSTR("variantClipCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.variantClipBytes)), RNCSTR("variantClipBytes"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.maskedBoneCount)), RNCSTR("maskedBoneCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.boundedBoneCount)), RNCSTR("boundedBoneCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.clipBoundsCount)), RNCSTR("clipBoundsCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.shaderPermutations.size())), RNCSTR("shaderPermutationCount"));
+			dictionary->SetObjectForKey(Number::WithUint32(static_cast<uint32>(statistics.newShaderPermutationCount)), RNCSTR("newShaderPermutationCount"));
+			
+			Dictionary *variants = new Dictionary();
+			for(auto &pair : statistics.textureVariants)
+				variants->SetObjectForKey(Number::WithUint32(static_cast<uint32>(pair.second)), RNSTR(pair.first.c_str()));
+			
+			Dictionary *paths = new Dictionary();
+			for(auto &pair : statistics.texturePaths)
+				paths->SetObjectForKey(RNSTR(pair.second.c_str()), RNSTR(pair.first.c_str()));
+			
+			dictionary->SetObjectForKey(variants->Autorelease(), RNCSTR("textureVariants"));
+			dictionary->SetObjectForKey(paths->Autorelease(), RNCSTR("texturePaths"));
+		}
+		
+		static bool IsLinearTextureType(aiTextureType aitexturetype)
+		{
+			return (aitexturetype == aiTextureType_NORMALS || aitexturetype == aiTextureType_HEIGHT || aitexturetype == aiTextureType_DISPLACEMENT);
+		}
+		
+		void AssimpResourceLoader::AddTexture(Material *material, const aiScene *scene, aiMaterial *aimaterial, LoadContext &context, aiTextureType aitexturetype)
+		{
+			if(context.deferTextures)
+			{
+				aiString aipath;
+				aimaterial->GetTexture(aitexturetype, 0, &aipath);
+				
+				TextureCache::ResolvedPath resolved;
+				if(aipath.data[0] != '*' && TextureCache::GetSharedInstance()->ResolveTexturePath(context.filepath, aipath, aitexturetype, resolved))
+				{
+					TextureCache::Request request = MakeTextureRequest(resolved, aitexturetype, context);
+					TextureResidency *residency = TextureResidency::GetSharedInstance();
+					
+					residency->AddDeferredTexture(material, material->GetTextures().size(), request);
+					material->AddTexture(residency->GetPlaceholder(request.IsLinear()));
+					
+					context.statistics.textureCount ++;
+					context.statistics.deferredTextureCount ++;
+					context.statistics.textureVariants[resolved.extension] ++;
+					context.statistics.texturePaths[aipath.C_Str()] = resolved.path;
+					return;
+				}
+			}
+			
+			material->AddTexture(GetTexture(scene, aimaterial, context, aitexturetype));
+		}
+		
+		Texture *AssimpResourceLoader::GetTexture(const aiScene *scene, aiMaterial *aimaterial, LoadContext &context, aiTextureType aitexturetype, uint8 index)
 		{
 			aiString aipath;
 			aimaterial->GetTexture(aitexturetype, index, &aipath);
 			
-			std::string base = PathManager::Basename(aipath.C_Str());
-			std::string extension = PathManager::Extension(aipath.C_Str());
+			bool linear = IsLinearTextureType(aitexturetype);
+			
+			if(aipath.data[0] == '*')
+			{
+				unsigned int textureindex = static_cast<unsigned int>(atoi(aipath.data + 1));
+				if(textureindex >= scene->mNumTextures)
+					throw Exception(Exception::Type::InconsistencyException, std::string("Invalid embedded texture ") + aipath.C_Str());
+				
+				context.statistics.textureCount ++;
+				context.statistics.embeddedTextureCount ++;
+				
+				// The cache already warned, a missing texture shouldn't fail the whole model
+				Texture *texture = TextureCache::GetSharedInstance()->GetEmbeddedTexture(scene->mTextures[textureindex], context.cachepath, linear);
+				return texture ? texture : TextureResidency::GetSharedInstance()->GetPlaceholder(linear);
+			}
+			
+			TextureCache::ResolvedPath resolved;
+			if(!TextureCache::GetSharedInstance()->ResolveTexturePath(context.filepath, aipath, aitexturetype, resolved))
+				throw Exception(Exception::Type::GenericException, std::string("Couldn't find texture ") + aipath.C_Str());
+			
+			context.statistics.textureCount ++;
+			context.statistics.textureVariants[resolved.extension] ++;
+			context.statistics.texturePaths[aipath.C_Str()] = resolved.path;
+			
+			return TextureCache::GetSharedInstance()->GetTexture(MakeTextureRequest(resolved, aitexturetype, context));
+		}
+		
+		TextureCache::Request AssimpResourceLoader::MakeTextureRequest(const TextureCache::ResolvedPath &resolved, aiTextureType aitexturetype, LoadContext &context)
+		{
+			TextureCache::Request request(resolved.path, aitexturetype);
+			request.cacheDirectory = context.cachepath;
+			
+			// Precompressed variants already carry their own mip chain, and decoding them to RGBA8888 for a bias
+			// would make the smaller copy larger than the compressed original
+			bool precompressed = (resolved.extension == "dds" || resolved.extension == "ktx");
+			
+			if(context.preprocessTextures && !precompressed)
+			{
+				request.preprocess = true;
+				context.statistics.preprocessedTextureCount ++;
+			}
 			
-			std::stringstream path;
-			path << PathManager::Join(filepath, base) << "." << extension;
+			if(context.mipBias > 0 && !precompressed)
+			{
+				request.mipBias = context.mipBias;
+				context.statistics.biasedTextureCount ++;
+			}
 			
-			bool linear = (aitexturetype == aiTextureType_NORMALS || aitexturetype == aiTextureType_HEIGHT || aitexturetype == aiTextureType_DISPLACEMENT);
+			return request;
+		}
+		
+		uint32 AssimpResourceLoader::GetMipBias(const std::vector<float> &lodFactors, size_t stage)
+		{
+			// Stage N becomes active at lodFactors[N - 1], the on screen size of its textures shrinks with the distance
+			// relative to where stage 1 kicks in. Every halving of the size drops one mip level.
+			if(stage < 2 || lodFactors[0] <= k::EpsilonFloat)
+				return 0;
 			
-			std::string normalized = FileManager::GetSharedInstance()->GetNormalizedPathFromFullpath(path.str());
-			return Texture::WithFile(normalized, linear);
+			float ratio = lodFactors[stage - 1] / lodFactors[0];
+			return static_cast<uint32>(std::max(0.0f, std::floor(std::log2(ratio))));
 		}
 		
-		void AssimpResourceLoader::LoadLODStage(const aiScene *scene, Model *model, size_t stage, const std::string &filepath, bool guessMaterial)
+		void AssimpResourceLoader::LoadLODStage(const aiScene *scene, Model *model, size_t stage, LoadContext &context)
 		{
 			Shader *shader = ResourceCoordinator::GetSharedInstance()->GetResourceWithName<Shader>(kRNResourceKeyDefaultShader, nullptr);
 			
-			int boneindexoffset = 0;
+			std::vector<bool> atlased(scene->mNumMeshes, false);
+			
+			if(context.atlasTextures)
+				LoadAtlasedMeshes(scene, model, stage, shader, context, atlased);
+			
+			if(context.skeletonLOD && !context.boneParents.empty())
+			{
+				if(context.boneMasks.size() <= stage)
+					context.boneMasks.resize(stage + 1);
+				
+				context.boneMasks[stage] = ComputeBoneMask(scene, context);
+			}
 			
 			for(int i = 0; i < scene->mNumMeshes; i++)
 			{
+				if(atlased[i])
+					continue;
+				
 				aiMesh *aimesh = scene->mMeshes[i];
 				aiMaterial *aimaterial = scene->mMaterials[aimesh->mMaterialIndex];
 				
-				Material *material = new Material(shader);
-				if(aimaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
-				{
-					material->AddTexture(GetTexture(aimaterial, filepath, aiTextureType_DIFFUSE));
-				}
-				
-				if(aimaterial->GetTextureCount(aiTextureType_NORMALS) > 0)
-				{
-					material->AddTexture(GetTexture(aimaterial, filepath, aiTextureType_NORMALS));
-					material->Define("RN_NORMALMAP");
-					
-				}
-				
-				if(aimaterial->GetTextureCount(aiTextureType_SPECULAR) > 0)
-				{
-					material->AddTexture(GetTexture(aimaterial, filepath, aiTextureType_SPECULAR));
-					material->Define("RN_SPECULARITY");
-					material->Define("RN_SPECMAP");
-				}
+				Material *material = CreateMaterial(scene, aimaterial, shader, context);
+				Mesh *mesh = CreateMesh(aimesh, stage, context);
 				
-				std::vector<MeshDescriptor> descriptors;
+				model->AddMesh(mesh, material, stage);
+			}
+		}
+		
+		static bool CanAtlasMesh(aiMesh *aimesh, aiMaterial *aimaterial)
+		{
+			if(aimesh->HasBones() || !aimesh->HasPositions() || !aimesh->HasNormals() || !aimesh->HasTextureCoords(0) || aimesh->HasTextureCoords(1))
+				return false;
+			
+			if(aimaterial->GetTextureCount(aiTextureType_DIFFUSE) != 1 || aimaterial->GetTextureCount(aiTextureType_NORMALS) > 0 || aimaterial->GetTextureCount(aiTextureType_SPECULAR) > 0)
+				return false;
+			
+			// Tiling UVs can't be remapped into an atlas region
+			for(unsigned int i = 0; i < aimesh->mNumVertices; i++)
+			{
+				const aiVector3D &uv = aimesh->mTextureCoords[0][i];
 				
-				MeshDescriptor meshDescriptor(MeshFeature::Vertices);
-				if(aimesh->HasPositions())
-				{
-					meshDescriptor.elementSize = sizeof(Vector3);
-					meshDescriptor.elementMember = 3;
-					descriptors.push_back(meshDescriptor);
-				}
+				if(uv.x < -0.001f || uv.x > 1.001f || uv.y < -0.001f || uv.y > 1.001f)
+					return false;
+			}
+			
+			return true;
+		}
+		
+		static uint64 HashFileContents(const std::string &path, uint64 hash)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			std::vector<char> buffer(64 * 1024);
+			
+			while(stream.good())
+			{
+				stream.read(buffer.data(), buffer.size());
+				hash = HashBytes(buffer.data(), static_cast<size_t>(stream.gcount()), hash);
+			}
+			
+			return hash;
+		}
+		
+		static aiMesh *MergeAtlasedMeshes(const aiScene *scene, const TextureAtlas &atlas, const std::vector<std::pair<size_t, TextureAtlas::Region>> &entries)
+		{
+			unsigned int vertexCount = 0;
+			unsigned int faceCount = 0;
+			bool tangents = true;
+			
+			for(auto &entry : entries)
+			{
+				aiMesh *aimesh = scene->mMeshes[entry.first];
 				
-				if(aimesh->HasNormals())
-				{
-					meshDescriptor = MeshDescriptor(MeshFeature::Normals);
-					meshDescriptor.elementSize = sizeof(Vector3);
-					meshDescriptor.elementMember = 3;
-					descriptors.push_back(meshDescriptor);
-				}
+				vertexCount += aimesh->mNumVertices;
+				faceCount += aimesh->mNumFaces;
+				tangents = tangents && aimesh->HasTangentsAndBitangents();
+			}
+			
+			aiMesh *merged = new aiMesh();
+			merged->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+			merged->mNumVertices = vertexCount;
+			merged->mVertices = new aiVector3D[vertexCount];
+			merged->mNormals = new aiVector3D[vertexCount];
+			merged->mTextureCoords[0] = new aiVector3D[vertexCount];
+			merged->mNumUVComponents[0] = 2;
+			merged->mFaces = new aiFace[faceCount];
+			
+			if(tangents)
+			{
+				merged->mTangents = new aiVector3D[vertexCount];
+				merged->mBitangents = new aiVector3D[vertexCount];
+			}
+			
+			unsigned int vertexOffset = 0;
+			
+			for(auto &entry : entries)
+			{
+				aiMesh *aimesh = scene->mMeshes[entry.first];
 				
-				if(aimesh->HasTextureCoords(0))
-				{
-					meshDescriptor = MeshDescriptor(MeshFeature::UVSet0);
-					meshDescriptor.elementSize = sizeof(Vector3);
-					meshDescriptor.elementMember = 3;
-					descriptors.push_back(meshDescriptor);
-				}
+				std::copy(aimesh->mVertices, aimesh->mVertices + aimesh->mNumVertices, merged->mVertices + vertexOffset);
+				std::copy(aimesh->mNormals, aimesh->mNormals + aimesh->mNumVertices, merged->mNormals + vertexOffset);
 				
-				if(aimesh->HasTextureCoords(1))
+				if(tangents)
 				{
-					meshDescriptor = MeshDescriptor(MeshFeature::UVSet1);
-					meshDescriptor.elementSize = sizeof(Vector3);
-					meshDescriptor.elementMember = 3;
-					descriptors.push_back(meshDescriptor);
+					std::copy(aimesh->mTangents, aimesh->mTangents + aimesh->mNumVertices, merged->mTangents + vertexOffset);
+					std::copy(aimesh->mBitangents, aimesh->mBitangents + aimesh->mNumVertices, merged->mBitangents + vertexOffset);
 				}
 				
-				if(aimesh->HasTangentsAndBitangents())
+				for(unsigned int i = 0; i < aimesh->mNumVertices; i++)
 				{
-					meshDescriptor = MeshDescriptor(MeshFeature::Tangents);
-					meshDescriptor.elementSize = sizeof(Vector4);
-					meshDescriptor.elementMember = 4;
-					descriptors.push_back(meshDescriptor);
+					const aiVector3D &uv = aimesh->mTextureCoords[0][i];
+					
+					float u = Math::Clamp(uv.x, 0.0f, 1.0f);
+					float v = Math::Clamp(uv.y, 0.0f, 1.0f);
+					
+					atlas.TransformUV(entry.second, u, v);
+					merged->mTextureCoords[0][vertexOffset + i] = aiVector3D(u, v, 0.0f);
 				}
 				
-				float *boneWeights = nullptr;
-				float *boneIndices = nullptr;
-				
-				if(aimesh->HasBones())
+				for(unsigned int i = 0; i < aimesh->mNumFaces; i++)
 				{
-					boneWeights = new float[aimesh->mNumVertices*4];
-					boneIndices = new float[aimesh->mNumVertices*4];
-					
-					std::fill(boneWeights, &boneWeights[aimesh->mNumVertices*4], -1.0f);
-					std::fill(boneIndices, &boneIndices[aimesh->mNumVertices*4], -1.0f);
-					
-					for(int ind = 0; ind < aimesh->mNumBones; ind++)
-					{
-						aiBone *aibone = aimesh->mBones[ind];
-						for(int w = 0; w < aibone->mNumWeights; w++)
-						{
-							aiVertexWeight *aiweight = &aibone->mWeights[w];
-							for(int n = 0; n < 4; n++)
-							{
-								if(boneWeights[aiweight->mVertexId*4+n] < -0.5f)
-								{
-									boneWeights[aiweight->mVertexId*4+n] = aiweight->mWeight;
-									boneIndices[aiweight->mVertexId*4+n] = ind+boneindexoffset;
-									boneIndices[aiweight->mVertexId*4+n] += 0.1f;
-									break;
-								}
-							}
-						}
-					}
-					
-					for(int ind = 0; ind < aimesh->mNumVertices; ind++)
-					{
-						for(int n = 0; n < 4; n++)
-						{
-							if(boneWeights[ind*4+n] < -0.5f)
-							{
-								boneWeights[ind*4+n] = 0.0f;
-								boneIndices[ind*4+n] = 0.0f;
-							}
-						}
-					}
+					const aiFace &face = aimesh->mFaces[i];
+					if(face.mNumIndices != 3)
+						continue;
 					
-					boneindexoffset += aimesh->mNumBones;
+					aiFace &target = merged->mFaces[merged->mNumFaces++];
+					target.mNumIndices = 3;
+					target.mIndices = new unsigned int[3];
 					
-					meshDescriptor = MeshDescriptor(MeshFeature::BoneIndices);
-					meshDescriptor.elementSize = sizeof(Vector4);
-					meshDescriptor.elementMember = 4;
-					descriptors.push_back(meshDescriptor);
-					
-					meshDescriptor = MeshDescriptor(MeshFeature::BoneWeights);
-					meshDescriptor.elementSize = sizeof(Vector4);
-					meshDescriptor.elementMember = 4;
-					descriptors.push_back(meshDescriptor);
+					for(unsigned int n = 0; n < 3; n++)
+						target.mIndices[n] = face.mIndices[n] + vertexOffset;
 				}
 				
-				uint32 indexCount = 0;
-				uint8 *indices = nullptr;
-				
-				if(aimesh->HasFaces())
-				{
-					uint8 indicesSize = 2;
-					if(aimesh->mNumFaces*3 > 65535)
-					{
-						indicesSize = 4;
-					}
-					
-					indices = new uint8[indicesSize*aimesh->mNumFaces*3];
-					for(int face = 0; face < aimesh->mNumFaces; face++)
-					{
-						if(aimesh->mFaces[face].mNumIndices != 3)
-						{
-							continue;
-						}
-						for(int ind = 0; ind < aimesh->mFaces[face].mNumIndices; ind++)
-						{
-							if(indicesSize == 2)
-							{
-								((uint16*)indices)[indexCount] = static_cast<uint16>(aimesh->mFaces[face].mIndices[ind]);
-							}
-							if(indicesSize == 4)
-							{
-								((uint32*)indices)[indexCount] = static_cast<uint32>(aimesh->mFaces[face].mIndices[ind]);
-							}
-							indexCount++;
-						}
-					}
+				vertexOffset += aimesh->mNumVertices;
+			}
+			
+			return merged;
+		}
+		
+		void AssimpResourceLoader::LoadAtlasedMeshes(const aiScene *scene, Model *model, size_t stage, Shader *shader, LoadContext &context, std::vector<bool> &atlased)
+		{
+			std::vector<size_t> candidates;
+			std::vector<std::string> candidatePaths;
+			std::vector<std::string> sources;
+			
+			for(size_t i = 0; i < scene->mNumMeshes; i++)
+			{
+				aiMesh *aimesh = scene->mMeshes[i];
+				aiMaterial *aimaterial = scene->mMaterials[aimesh->mMaterialIndex];
+				
+				if(!CanAtlasMesh(aimesh, aimaterial))
+					continue;
+				
+				aiString aipath;
+				aimaterial->GetTexture(aiTextureType_DIFFUSE, 0, &aipath);
+				
+				TextureCache::ResolvedPath resolved;
+				if(aipath.data[0] == '*' || !TextureCache::GetSharedInstance()->ResolveTexturePath(context.filepath, aipath, aiTextureType_DIFFUSE, resolved))
+					continue;
+				
+				candidates.push_back(i);
+				candidatePaths.push_back(resolved.path);
+				
+				if(std::find(sources.begin(), sources.end(), resolved.path) == sources.end())
+					sources.push_back(resolved.path);
+			}
+			
+			if(sources.size() < 2)
+				return;
+			
+			// The baked atlas is keyed by the contents of its sources and the settings, so edited or added textures produce a new one
+			std::sort(sources.begin(), sources.end());
+			
+			uint64 hash = HashBytes(&context.atlasPageSize, sizeof(context.atlasPageSize));
+			hash = HashBytes(&context.atlasMaxTextureSize, sizeof(context.atlasMaxTextureSize), hash);
+			
+			for(const std::string &source : sources)
+			{
+				hash = HashBytes(source.data(), source.length() + 1, hash);
+				hash = HashFileContents(source, hash);
+			}
+			
+			std::stringstream name;
+			name << "atlas-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+			
+			std::string atlaspath = PathManager::Join(context.cachepath, name.str());
+			
+			TextureAtlas atlas(context.atlasPageSize, 4);
+			
+			if(!atlas.ReadFromFile(atlaspath))
+			{
+				std::vector<TextureAtlas::Image> images;
+				
+				for(const std::string &source : sources)
+				{
+					Texture *texture = Texture::WithFile(source, false);
+					if(texture->GetWidth() > context.atlasMaxTextureSize || texture->GetHeight() > context.atlasMaxTextureSize)
+						continue;
+					
+					TextureAtlas::Image image;
+					image.name = source;
+					image.width = texture->GetWidth();
+					image.height = texture->GetHeight();
+					image.pixels.resize(image.width * image.height * 4);
 					
-					meshDescriptor = MeshDescriptor(MeshFeature::Indices);
-					meshDescriptor.elementSize = indicesSize;
-					meshDescriptor.elementMember = 1;
-					descriptors.push_back(meshDescriptor);
+					texture->GetData(image.pixels.data(), Texture::Format::RGBA8888);
+					images.push_back(std::move(image));
 				}
 				
-				Mesh *mesh = new Mesh(descriptors, aimesh->mNumVertices, indexCount);
-				Mesh::Chunk chunk = mesh->GetChunk();
+				atlas.Pack(images);
 				
-				if(aimesh->HasPositions())
+				// The packed atlas is already in memory, a failed write only costs the next load a repack
+				try
 				{
-					chunk.SetData(aimesh->mVertices, MeshFeature::Vertices);
+					PathManager::CreatePath(context.cachepath);
+					atlas.WriteToFile(atlaspath);
 				}
-				
-				if(aimesh->HasTextureCoords(0))
+				catch(Exception e)
 				{
-					chunk.SetData(aimesh->mTextureCoords[0], MeshFeature::UVSet0);
+					RNWarning("Couldn't write texture atlas " << atlaspath);
 				}
+			}
+			
+			std::map<uint32, std::vector<std::pair<size_t, TextureAtlas::Region>>> pages;
+			
+			for(size_t i = 0; i < candidates.size(); i++)
+			{
+				TextureAtlas::Region region;
+				if(atlas.GetRegion(candidatePaths[i], region))
+					pages[region.page].push_back(std::make_pair(candidates[i], region));
+			}
+			
+			for(auto &pair : pages)
+			{
+				aiMesh *merged = MergeAtlasedMeshes(scene, atlas, pair.second);
+				
+				Mesh *mesh = CreateMesh(merged, stage, context);
+				delete merged;
+				
+				Material *material = new Material(shader);
+				material->AddTexture(atlas.CreatePageTexture(pair.first));
+				
+				RecordDefines(std::vector<std::string>(), context);
 				
-				if(aimesh->HasTextureCoords(1))
+				model->AddMesh(mesh, material, stage);
+				
+				for(auto &entry : pair.second)
+					atlased[entry.first] = true;
+				
+				context.statistics.atlasPageCount ++;
+				context.statistics.atlasedMeshCount += pair.second.size();
+			}
+		}
+		
+		Material *AssimpResourceLoader::CreateMaterial(const aiScene *scene, aiMaterial *aimaterial, Shader *shader, LoadContext &context)
+		{
+			Material *material = new Material(shader);
+			std::vector<std::string> defines;
+			
+			if(aimaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+			{
+				AddTexture(material, scene, aimaterial, context, aiTextureType_DIFFUSE);
+			}
+			
+			if(aimaterial->GetTextureCount(aiTextureType_NORMALS) > 0)
+			{
+				AddTexture(material, scene, aimaterial, context, aiTextureType_NORMALS);
+				defines.push_back("RN_NORMALMAP");
+			}
+			
+			if(aimaterial->GetTextureCount(aiTextureType_SPECULAR) > 0)
+			{
+				AddTexture(material, scene, aimaterial, context, aiTextureType_SPECULAR);
+				defines.push_back("RN_SPECULARITY");
+				defines.push_back("RN_SPECMAP");
+			}
+			
+			for(const std::string &define : defines)
+				material->Define(define);
+			
+			RecordDefines(defines, context);
+			return material;
+		}
+		
+		void AssimpResourceLoader::RecordDefines(const std::vector<std::string> &defines, LoadContext &context)
+		{
+			if(ShaderManifest::GetSharedInstance()->AddDefines(defines))
+				context.statistics.newShaderPermutationCount ++;
+			
+			context.statistics.shaderPermutations.insert(ShaderManifest::GetSignature(defines));
+		}
+		
+		std::vector<bool> AssimpResourceLoader::ComputeBoneMask(const aiScene *scene, const LoadContext &context)
+		{
+			size_t bonecount = context.boneParents.size();
+			std::vector<float> maxweights(bonecount, 0.0f);
+			
+			for(int i = 0; i < scene->mNumMeshes; i++)
+			{
+				aiMesh *aimesh = scene->mMeshes[i];
+				for(int b = 0; b < aimesh->mNumBones; b++)
 				{
-					chunk.SetData(aimesh->mTextureCoords[1], MeshFeature::UVSet1);
+					aiBone *aibone = aimesh->mBones[b];
+					
+					auto iterator = context.boneIndices.find(NameTable::GetSharedInstance()->FindID(aibone->mName.data, aibone->mName.length));
+					if(iterator == context.boneIndices.end())
+						continue;
+					
+					for(int w = 0; w < aibone->mNumWeights; w++)
+						maxweights[iterator->second] = std::max(maxweights[iterator->second], aibone->mWeights[w].mWeight);
 				}
+			}
+			
+			std::vector<bool> mask(bonecount, false);
+			for(size_t i = 0; i < bonecount; i++)
+				mask[i] = (maxweights[i] > context.skeletonLODWeight);
+			
+			//Keep the ancestors of kept bones so their global transform can be evaluated, children come after their parent
+			for(size_t i = bonecount; i-- > 0;)
+			{
+				if(mask[i] && context.boneParents[i] >= 0)
+					mask[context.boneParents[i]] = true;
+			}
+			
+			//Dropped bones without any kept ancestor collapse into their root
+			for(size_t i = 0; i < bonecount; i++)
+			{
+				if(maxweights[i] <= 0.0f || mask[i])
+					continue;
+				
+				size_t bone = i;
+				while(!mask[bone] && context.boneParents[bone] >= 0)
+					bone = context.boneParents[bone];
+				
+				mask[bone] = true;
+			}
+			
+			return mask;
+		}
+		
+		Mesh *AssimpResourceLoader::CreateMesh(aiMesh *aimesh, size_t stage, const LoadContext &context)
+		{
+			std::vector<MeshDescriptor> descriptors;
+			
+			MeshDescriptor meshDescriptor(MeshFeature::Vertices);
+			if(aimesh->HasPositions())
+			{
+				meshDescriptor.elementSize = sizeof(Vector3);
+				meshDescriptor.elementMember = 3;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			if(aimesh->HasNormals())
+			{
+				meshDescriptor = MeshDescriptor(MeshFeature::Normals);
+				meshDescriptor.elementSize = sizeof(Vector3);
+				meshDescriptor.elementMember = 3;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			if(aimesh->HasTextureCoords(0))
+			{
+				meshDescriptor = MeshDescriptor(MeshFeature::UVSet0);
+				meshDescriptor.elementSize = sizeof(Vector3);
+				meshDescriptor.elementMember = 3;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			if(aimesh->HasTextureCoords(1))
+			{
+				meshDescriptor = MeshDescriptor(MeshFeature::UVSet1);
+				meshDescriptor.elementSize = sizeof(Vector3);
+				meshDescriptor.elementMember = 3;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			if(aimesh->HasTangentsAndBitangents())
+			{
+				meshDescriptor = MeshDescriptor(MeshFeature::Tangents);
+				meshDescriptor.elementSize = sizeof(Vector4);
+				meshDescriptor.elementMember = 4;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			float *boneWeights = nullptr;
+			float *boneIndices = nullptr;
+			
+			if(aimesh->HasBones())
+			{
+				const std::vector<bool> *mask = (stage < context.boneMasks.size() && !context.boneMasks[stage].empty()) ? &context.boneMasks[stage] : nullptr;
+				
+				boneWeights = new float[aimesh->mNumVertices*4];
+				boneIndices = new float[aimesh->mNumVertices*4];
+				
+				std::fill(boneWeights, &boneWeights[aimesh->mNumVertices*4], -1.0f);
+				std::fill(boneIndices, &boneIndices[aimesh->mNumVertices*4], -1.0f);
 				
-				if(aimesh->HasTangentsAndBitangents())
+				for(int ind = 0; ind < aimesh->mNumBones; ind++)
 				{
-					Mesh::ElementIterator<Vector4> it = chunk.GetIterator<Vector4>(MeshFeature::Tangents);
+					aiBone *aibone = aimesh->mBones[ind];
 					
-					for(int ind = 0; ind < aimesh->mNumVertices; ind++)
+					// LOD stages can reference bones the skeleton doesn't know about, their influence is dropped
+					auto iterator = context.boneIndices.find(NameTable::GetSharedInstance()->FindID(aibone->mName.data, aibone->mName.length));
+					if(iterator == context.boneIndices.end())
+						continue;
+					
+					size_t bone = iterator->second;
+					
+					// Weights of bones the stage drops go to the nearest kept ancestor
+					if(mask)
 					{
-						Vector4 tangent(aimesh->mTangents[ind].x, aimesh->mTangents[ind].y, aimesh->mTangents[ind].z, 0.0f);
-						Vector3 normal(aimesh->mNormals[ind].x, aimesh->mNormals[ind].y, aimesh->mNormals[ind].z);
-						Vector3 binormal(aimesh->mBitangents[ind].x, aimesh->mBitangents[ind].y, aimesh->mBitangents[ind].z);
-						Vector3 inversebinormal = normal.GetCrossProduct(Vector3(tangent));
-						
-						if(binormal.GetDotProduct(inversebinormal) > 0.0f)
-						{
-							tangent.w = 1.0f;
-						}
-						else
-						{
-							tangent.w = -1.0f;
-						}
-						
-						if(isnan(normal.x) || isnan(normal.y) || isnan(normal.z))
+						while(!(*mask)[bone] && context.boneParents[bone] >= 0)
+							bone = context.boneParents[bone];
+					}
+					
+					float boneindex = static_cast<float>(bone) + 0.1f;
+					
+					for(int w = 0; w < aibone->mNumWeights; w++)
+					{
+						aiVertexWeight *aiweight = &aibone->mWeights[w];
+						for(int n = 0; n < 4; n++)
 						{
-							normal = RN::Vector3(0.0f, -1.0f, 0.0f);
-							aimesh->mNormals[ind].x = 0.0f;
-							aimesh->mNormals[ind].y = -1.0f;
-							aimesh->mNormals[ind].z = 0.0f;
+							if(boneWeights[aiweight->mVertexId*4+n] >= -0.5f && boneIndices[aiweight->mVertexId*4+n] == boneindex)
+							{
+								boneWeights[aiweight->mVertexId*4+n] += aiweight->mWeight;
+								break;
+							}
+							
+							if(boneWeights[aiweight->mVertexId*4+n] < -0.5f)
+							{
+								boneWeights[aiweight->mVertexId*4+n] = aiweight->mWeight;
+								boneIndices[aiweight->mVertexId*4+n] = boneindex;
+								break;
+							}
 						}
-						
-						if(isnan(tangent.x) || isnan(tangent.y) || isnan(tangent.z))
+					}
+				}
+				
+				for(int ind = 0; ind < aimesh->mNumVertices; ind++)
+				{
+					for(int n = 0; n < 4; n++)
+					{
+						if(boneWeights[ind*4+n] < -0.5f)
 						{
-							Vector3 newnormal(normal);
-							newnormal.x += 1.0f;
-							tangent = Vector4(newnormal.GetCrossProduct(normal).Normalize(), 1.0f);
+							boneWeights[ind*4+n] = 0.0f;
+							boneIndices[ind*4+n] = 0.0f;
 						}
-						
-						it->x = tangent.x;
-						it->y = tangent.y;
-						it->z = tangent.z;
-						it->w = tangent.w;
-						it++;
 					}
 				}
 				
-				if(aimesh->HasNormals())
+				meshDescriptor = MeshDescriptor(MeshFeature::BoneIndices);
+				meshDescriptor.elementSize = sizeof(Vector4);
+				meshDescriptor.elementMember = 4;
+				descriptors.push_back(meshDescriptor);
+				
+				meshDescriptor = MeshDescriptor(MeshFeature::BoneWeights);
+				meshDescriptor.elementSize = sizeof(Vector4);
+				meshDescriptor.elementMember = 4;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			uint32 indexCount = 0;
+			uint8 *indices = nullptr;
+			
+			if(aimesh->HasFaces())
+			{
+				uint8 indicesSize = 2;
+				if(aimesh->mNumFaces*3 > 65535)
 				{
-					chunk.SetData(aimesh->mNormals, MeshFeature::Normals);
+					indicesSize = 4;
 				}
 				
-				if(aimesh->HasBones())
+				indices = new uint8[indicesSize*aimesh->mNumFaces*3];
+				for(int face = 0; face < aimesh->mNumFaces; face++)
 				{
-					chunk.SetData(boneWeights, MeshFeature::BoneWeights);
-					chunk.SetData(boneIndices, MeshFeature::BoneIndices);
+					if(aimesh->mFaces[face].mNumIndices != 3)
+					{
+						continue;
+					}
+					for(int ind = 0; ind < aimesh->mFaces[face].mNumIndices; ind++)
+					{
+						if(indicesSize == 2)
+						{
+							((uint16*)indices)[indexCount] = static_cast<uint16>(aimesh->mFaces[face].mIndices[ind]);
+						}
+						if(indicesSize == 4)
+						{
+							((uint32*)indices)[indexCount] = static_cast<uint32>(aimesh->mFaces[face].mIndices[ind]);
+						}
+						indexCount++;
+					}
 				}
 				
-				chunk.CommitChanges();
+				meshDescriptor = MeshDescriptor(MeshFeature::Indices);
+				meshDescriptor.elementSize = indicesSize;
+				meshDescriptor.elementMember = 1;
+				descriptors.push_back(meshDescriptor);
+			}
+			
+			Mesh *mesh = new Mesh(descriptors, aimesh->mNumVertices, indexCount);
+			Mesh::Chunk chunk = mesh->GetChunk();
+			
+			if(aimesh->HasPositions())
+			{
+				chunk.SetData(aimesh->mVertices, MeshFeature::Vertices);
+			}
+			
+			if(aimesh->HasTextureCoords(0))
+			{
+				chunk.SetData(aimesh->mTextureCoords[0], MeshFeature::UVSet0);
+			}
+			
+			if(aimesh->HasTextureCoords(1))
+			{
+				chunk.SetData(aimesh->mTextureCoords[1], MeshFeature::UVSet1);
+			}
+			
+			if(aimesh->HasTangentsAndBitangents())
+			{
+				Mesh::ElementIterator<Vector4> it = chunk.GetIterator<Vector4>(MeshFeature::Tangents);
 				
-				if(aimesh->HasFaces())
+				for(int ind = 0; ind < aimesh->mNumVertices; ind++)
 				{
-					chunk = mesh->GetIndicesChunk();
-					chunk.SetData(indices, MeshFeature::Indices);
-					delete[] indices;
-					chunk.CommitChanges();
+					Vector4 tangent(aimesh->mTangents[ind].x, aimesh->mTangents[ind].y, aimesh->mTangents[ind].z, 0.0f);
+					Vector3 normal(aimesh->mNormals[ind].x, aimesh->mNormals[ind].y, aimesh->mNormals[ind].z);
+					Vector3 binormal(aimesh->mBitangents[ind].x, aimesh->mBitangents[ind].y, aimesh->mBitangents[ind].z);
+					Vector3 inversebinormal = normal.GetCrossProduct(Vector3(tangent));
+					
+					if(binormal.GetDotProduct(inversebinormal) > 0.0f)
+					{
+						tangent.w = 1.0f;
+					}
+					else
+					{
+						tangent.w = -1.0f;
+					}
+					
+					if(isnan(normal.x) || isnan(normal.y) || isnan(normal.z))
+					{
+						normal = RN::Vector3(0.0f, -1.0f, 0.0f);
+						aimesh->mNormals[ind].x = 0.0f;
+						aimesh->mNormals[ind].y = -1.0f;
+						aimesh->mNormals[ind].z = 0.0f;
+					}
+					
+					if(isnan(tangent.x) || isnan(tangent.y) || isnan(tangent.z))
+					{
+						Vector3 newnormal(normal);
+						newnormal.x += 1.0f;
+						tangent = Vector4(newnormal.GetCrossProduct(normal).Normalize(), 1.0f);
+					}
+					
+					it->x = tangent.x;
+					it->y = tangent.y;
+					it->z = tangent.z;
+					it->w = tangent.w;
+					it++;
 				}
-				
-				mesh->CalculateBoundingVolumes();
-				model->AddMesh(mesh, material, stage);
 			}
-		}
-		
-		void AssimpResourceLoader::WalkForgottenBones(aiNode *ainode, std::vector<aiNode*> &ainodes)
-		{
-			if(std::find(ainodes.begin(), ainodes.end(), ainode) == ainodes.end())
+			
+			if(aimesh->HasNormals())
+			{
+				chunk.SetData(aimesh->mNormals, MeshFeature::Normals);
+			}
+			
+			if(aimesh->HasBones())
+			{
+				chunk.SetData(boneWeights, MeshFeature::BoneWeights);
+				chunk.SetData(boneIndices, MeshFeature::BoneIndices);
+			}
+			
+			chunk.CommitChanges();
+			
+			if(aimesh->HasFaces())
 			{
-				ainodes.push_back(ainode);
-				if(ainode->mParent)
-					WalkForgottenBones(ainode->mParent, ainodes);
+				chunk = mesh->GetIndicesChunk();
+				chunk.SetData(indices, MeshFeature::Indices);
+				delete[] indices;
+				chunk.CommitChanges();
 			}
+			
+			mesh->CalculateBoundingVolumes();
+			return mesh;
 		}
 		
 		void AssimpResourceLoader::CopyMatrix(aiMatrix4x4 &from, Matrix &to)
@@ -476,105 +1302,204 @@ namespace RN
 			to.d1 = from.m[15];
 		}
 		
-		void AssimpResourceLoader::LoadSkeleton(const aiScene* scene, RN::Model *model)
+		void AssimpResourceLoader::MapBones(const aiScene *scene, SceneIndex &index, LoadContext &context)
 		{
-			Skeleton *skeleton = new Skeleton();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			
+			// Bones are identified by their scene node, a bone influencing several meshes is only added once
+			std::vector<bool> isbonenode(index.GetNodeCount(), false);
 			
-			//Create list of valid bones
-			std::vector<aiNode*> aibonenodes;
 			for(int i = 0; i < scene->mNumMeshes; i++)
 			{
 				aiMesh *aimesh = scene->mMeshes[i];
 				for(int b = 0; b < aimesh->mNumBones; b++)
 				{
 					aiBone *aibone = aimesh->mBones[b];
-					aiNode *ainode = scene->mRootNode->FindNode(aibone->mName);
-					aibonenodes.push_back(ainode);
+					size_t node = index.FindNode(aibone->mName);
+					if(node == SceneIndex::InvalidIndex)
+						throw Exception(Exception::Type::InconsistencyException, std::string("Couldn't find node for bone ") + aibone->mName.C_Str());
+					
+					isbonenode[node] = true;
+					context.statistics.meshBoneCount ++;
 				}
 			}
 			
-			size_t numusednodes = aibonenodes.size();
+			//Add the unattached nodes between the bones and the scene root, children come after their parent in the index
+			for(size_t i = index.GetNodeCount(); i-- > 0;)
+			{
+				size_t parent = index.GetNode(i).parent;
+				if(isbonenode[i] && parent != SceneIndex::InvalidIndex)
+					isbonenode[parent] = true;
+			}
+			
+			NameTable *names = NameTable::GetSharedInstance();
+			
+			//Bones keep the node order, so every bone comes after its parent
+			for(size_t i = 0; i < index.GetNodeCount(); i++)
+			{
+				if(!isbonenode[i])
+					continue;
+				
+				const SceneIndex::Node &node = index.GetNode(i);
+				int32 parent = (node.parent != SceneIndex::InvalidIndex) ? static_cast<int32>(index.GetNode(node.parent).bones.front()) : -1;
+				size_t bone = context.boneNodes.size();
+				
+				index.AddBone(i, bone);
+				context.boneNodes.push_back(i);
+				context.boneParents.push_back(parent);
+				context.boneNames.push_back(names->GetID(node.node->mName.data, node.node->mName.length));
+				context.boneIndices.insert(std::make_pair(names->GetID(node.node->mName.data, node.node->mName.length), bone));
+			}
+			
+			context.statistics.skeletonTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		static double GetTicksPerSecond(aiAnimation *aianimation)
+		{
+			return (aianimation->mTicksPerSecond > 0.0) ? aianimation->mTicksPerSecond : 25.0;
+		}
+		
+		// Field by field, the key structs have padding
+		static uint64 HashVectorKeys(const aiVectorKey *keys, unsigned int count, uint64 hash)
+		{
+			for(unsigned int i = 0; i < count; i++)
+			{
+				hash = HashBytes(&keys[i].mTime, sizeof(keys[i].mTime), hash);
+				hash = HashBytes(&keys[i].mValue, sizeof(keys[i].mValue), hash);
+			}
+			
+			return hash;
+		}
+		
+		static uint64 HashQuatKeys(const aiQuatKey *keys, unsigned int count, uint64 hash)
+		{
+			for(unsigned int i = 0; i < count; i++)
+			{
+				hash = HashBytes(&keys[i].mTime, sizeof(keys[i].mTime), hash);
+				hash = HashBytes(&keys[i].mValue, sizeof(keys[i].mValue), hash);
+			}
+			
+			return hash;
+		}
+		
+		uint64 AssimpResourceLoader::HashAnimations(const aiScene *scene, const LoadContext &context, uint64 hash)
+		{
+			// Everything that changes the clips built from the scene. Hashing the keys is a single pass over them,
+			// far cheaper than the conversion a shared rig skips, and keeps edited or merely same shaped clips apart.
+			hash = HashBytes(&context.animationKeyframes, sizeof(context.animationKeyframes), hash);
+			hash = HashBytes(&context.animationChannels, sizeof(context.animationChannels), hash);
+			hash = HashBytes(&context.animationSampleRate, sizeof(context.animationSampleRate), hash);
+			hash = HashBytes(context.animationLODRates.data(), context.animationLODRates.size() * sizeof(float), hash);
+			hash = HashBytes(&context.lazyAnimations, sizeof(context.lazyAnimations), hash);
+			hash = HashBytes(&context.compressAnimations, sizeof(context.compressAnimations), hash);
+			hash = HashBytes(&context.compression, sizeof(context.compression), hash);
+			hash = HashBytes(&context.streamDuration, sizeof(context.streamDuration), hash);
+			hash = HashBytes(&context.streamBlockDuration, sizeof(context.streamBlockDuration), hash);
+			hash = HashBytes(&context.streamWindowBlocks, sizeof(context.streamWindowBlocks), hash);
+			hash = HashBytes(&context.paletteSampleRate, sizeof(context.paletteSampleRate), hash);
+			hash = HashBytes(&context.paletteHalfFloat, sizeof(context.paletteHalfFloat), hash);
+			
+			for(const std::string &animation : context.paletteAnimations)
+				hash = HashBytes(animation.data(), animation.length() + 1, hash);
+			
+			for(const AnimationRange &range : context.animationRanges)
+			{
+				hash = HashBytes(range.animation.data(), range.animation.length() + 1, hash);
+				hash = HashBytes(range.name.data(), range.name.length() + 1, hash);
+				hash = HashBytes(&range.start, sizeof(range.start), hash);
+				hash = HashBytes(&range.end, sizeof(range.end), hash);
+			}
+			
+			// Bone masks and skinned bounds are merged into the shared layout, so rigs with other settings get their own
+			hash = HashBytes(&context.skeletonLOD, sizeof(context.skeletonLOD), hash);
+			hash = HashBytes(&context.skeletonLODWeight, sizeof(context.skeletonLODWeight), hash);
+			hash = HashBytes(&context.skinnedBounds, sizeof(context.skinnedBounds), hash);
+			hash = HashBytes(&context.skinnedBoundsWeight, sizeof(context.skinnedBoundsWeight), hash);
+			hash = HashBytes(&context.skinnedBoundsRate, sizeof(context.skinnedBoundsRate), hash);
 			
-			//Find unattached bones and add them to the end of the list
-			for(int i = 0; i < aibonenodes.size(); i++)
+			for(unsigned int i = 0; i < scene->mNumAnimations; i++)
 			{
-				aiNode *ainode = aibonenodes[i];
-				if(ainode->mParent && std::find(aibonenodes.begin(), aibonenodes.end(), ainode->mParent) == aibonenodes.end())
+				aiAnimation *aianimation = scene->mAnimations[i];
+				
+				hash = HashBytes(aianimation->mName.data, aianimation->mName.length, hash);
+				hash = HashBytes(&aianimation->mDuration, sizeof(aianimation->mDuration), hash);
+				hash = HashBytes(&aianimation->mTicksPerSecond, sizeof(aianimation->mTicksPerSecond), hash);
+				
+				for(unsigned int n = 0; n < aianimation->mNumChannels; n++)
 				{
-					WalkForgottenBones(ainode->mParent, aibonenodes);
+					aiNodeAnim *channel = aianimation->mChannels[n];
+					unsigned int counts[3] = { channel->mNumPositionKeys, channel->mNumRotationKeys, channel->mNumScalingKeys };
+					
+					hash = HashBytes(channel->mNodeName.data, channel->mNodeName.length, hash);
+					hash = HashBytes(counts, sizeof(counts), hash);
+					
+					hash = HashVectorKeys(channel->mPositionKeys, channel->mNumPositionKeys, hash);
+					hash = HashQuatKeys(channel->mRotationKeys, channel->mNumRotationKeys, hash);
+					hash = HashVectorKeys(channel->mScalingKeys, channel->mNumScalingKeys, hash);
 				}
 			}
 			
-			//list of nodes that are already used as children
-			std::vector<size_t> ainodechildren;
+			return hash;
+		}
+		
+		void AssimpResourceLoader::LoadSkeleton(const aiScene* scene, const SceneIndex &index, RN::Model *model, LoadContext &context)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			
+			Skeleton *skeleton = new Skeleton();
+			SkeletonLayout *layout = new SkeletonLayout();
+			
+			size_t bonecount = context.boneNodes.size();
+			
+			NameTable *names = NameTable::GetSharedInstance();
 			
-			//create valid bones, determine if they are root bones and add the valid children
+			//Meshes sharing a bone use the offset matrix of the first one
+			std::vector<aiBone *> aibones(bonecount, nullptr);
 			for(int i = 0; i < scene->mNumMeshes; i++)
 			{
 				aiMesh *aimesh = scene->mMeshes[i];
 				for(int b = 0; b < aimesh->mNumBones; b++)
 				{
 					aiBone *aibone = aimesh->mBones[b];
-					aiNode *ainode = scene->mRootNode->FindNode(aibone->mName);
-					
-					Matrix basemat;
-					CopyMatrix(aibone->mOffsetMatrix, basemat);
-					Bone bone(basemat, std::string(aibone->mName.C_Str()), !ainode->mParent, true);
-					
-					if(ainode)
-					{
-						for(int c = 0; c < ainode->mNumChildren; c++)
-						{
-							auto aichild = std::find(aibonenodes.begin(), aibonenodes.end(), ainode->mChildren[c]);
-							while(aichild != aibonenodes.end())
-							{
-								size_t index = std::distance(aibonenodes.begin(), aichild);
-								if(std::find(ainodechildren.begin(), ainodechildren.end(), index) == ainodechildren.end())
-								{
-									bone.tempChildren.push_back(index);
-									ainodechildren.push_back(index);
-								}
-								aichild = std::find(++aichild, aibonenodes.end(), ainode->mChildren[c]);
-							}
-						}
-					}
-					
-					skeleton->bones.push_back(bone);
+					size_t bone = context.boneIndices[names->GetID(aibone->mName.data, aibone->mName.length)];
+					if(!aibones[bone])
+						aibones[bone] = aibone;
 				}
 			}
 			
-			//Add additional bones to the skeleton
-			for(auto it = aibonenodes.begin()+numusednodes; it != aibonenodes.end(); it++)
+			//Create the bones in parent before child order, nodes without an aiBone use their inverse global transform
+			std::vector<aiMatrix4x4> aiglobals(bonecount);
+			uint64 fingerprint = HashBytes(&bonecount, sizeof(bonecount));
+			
+			for(size_t i = 0; i < bonecount; i++)
 			{
-				aiMatrix4x4 aiOffsetMatrix = (*it)->mTransformation;
-				for(aiNode *aiparent = (*it)->mParent; aiparent; aiparent = aiparent->mParent)
-				{
-					aiOffsetMatrix = aiparent->mTransformation*aiOffsetMatrix;
-				}
+				aiNode *ainode = index.GetNode(context.boneNodes[i]).node;
+				int32 parent = context.boneParents[i];
 				
-				Matrix basemat;
-				CopyMatrix(aiOffsetMatrix, basemat);
-				Bone bone(basemat.GetInverse(), std::string((*it)->mName.C_Str()), !(*it)->mParent, true);
+				aiglobals[i] = (parent >= 0) ? aiglobals[parent] * ainode->mTransformation : ainode->mTransformation;
 				
-				if(*it)
+				Matrix basemat;
+				if(aibones[i])
 				{
-					for(int c = 0; c < (*it)->mNumChildren; c++)
-					{
-						auto aichild = std::find(aibonenodes.begin(), aibonenodes.end(), (*it)->mChildren[c]);
-						while(aichild != aibonenodes.end())
-						{
-							size_t index = std::distance(aibonenodes.begin(), aichild);
-							if(std::find(ainodechildren.begin(), ainodechildren.end(), index) == ainodechildren.end())
-							{
-								bone.tempChildren.push_back(index);
-								ainodechildren.push_back(index);
-							}
-							aichild = std::find(++aichild, aibonenodes.end(), (*it)->mChildren[c]);
-						}
-					}
+					CopyMatrix(aibones[i]->mOffsetMatrix, basemat);
+				}
+				else
+				{
+					CopyMatrix(aiglobals[i], basemat);
+					basemat = basemat.GetInverse();
 				}
 				
+				fingerprint = HashBytes(&parent, sizeof(parent), fingerprint);
+				fingerprint = HashBytes(ainode->mName.data, ainode->mName.length, fingerprint);
+				fingerprint = HashBytes(basemat.m, sizeof(basemat.m), fingerprint);
+				
+				Bone bone(basemat, std::string(ainode->mName.C_Str()), (parent < 0), true);
 				skeleton->bones.push_back(bone);
+				layout->AddBone(parent, names->GetID(ainode->mName.data, ainode->mName.length));
+				layout->SetBoneOffset(i, basemat);
+				
+				if(parent >= 0)
+					skeleton->bones[parent].tempChildren.push_back(i);
 			}
 			
 			//Initialize skeleton
@@ -588,141 +1513,919 @@ namespace RN
 				localskinningmatrices.insert(std::pair<size_t, Matrix>(boneindex++, bone.relBaseMatrix.GetInverse()));
 			}*/
 			
+			//Identical rigs with the same clips share the layout and animations of the first skeleton loaded
+			if(context.shareSkeletons)
+				fingerprint = HashAnimations(scene, context, fingerprint);
+			
+			if(context.shareSkeletons && RigCache::GetSharedInstance()->Acquire(fingerprint, skeleton))
+			{
+				context.statistics.sharedSkeletonCount ++;
+			}
+			else
+			{
+				LoadAnimations(scene, index, layout, context);
+				
+				layout->SyncAnimations(skeleton);
+				SkeletonLayout::SetLayoutForSkeleton(skeleton, layout);
+				
+				if(context.shareSkeletons)
+					RigCache::GetSharedInstance()->Add(fingerprint, layout);
+			}
+			
+			//Shared rigs merge the bone boxes of every model using them, so the clip bounds are recomputed for the merged boxes
+			if(context.skinnedBounds)
+			{
+				SkeletonLayout *target = SkeletonLayout::GetLayoutForSkeleton(skeleton);
+				
+				CreateBoneBounds(scene, target, context);
+				CreateClipBounds(scene, index, target, context);
+			}
+			
+			layout->Release();
+			model->SetSkeleton(skeleton);
+			
+			context.statistics.boneCount = skeleton->bones.size();
+			context.statistics.sceneNodeCount = index.GetNodeCount();
+			context.statistics.skeletonTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		void AssimpResourceLoader::LoadAnimationLibrary(File *file, Skeleton *skeleton, LoadContext &context)
+		{
+			SkeletonLayout *layout = SkeletonLayout::GetLayoutForSkeleton(skeleton);
+			if(!layout)
+				throw Exception(Exception::Type::InconsistencyException, "Animation libraries can only be added to skeletons loaded by the assimp loader");
+			
+			// Only the node hierarchy and the animations are used, so none of the geometry post processing steps run
+			Assimp::Importer importer;
+			
+			const aiScene *scene = importer.ReadFile(file->GetFullPath(), 0);
+			if(!scene)
+				throw Exception(Exception::Type::GenericException, importer.GetErrorString());
+			
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			
+			SceneIndex index(scene);
+			NameTable *names = NameTable::GetSharedInstance();
+			
+			// Channels are matched to the skeleton by bone name, the library's own rig only provides the rest pose
+			for(size_t bone = 0; bone < layout->GetBoneCount(); bone++)
+			{
+				const std::string &name = names->GetName(layout->GetBoneName(bone));
+				size_t node = index.FindNode(aiString(name));
+				
+				if(node != SceneIndex::InvalidIndex)
+					index.AddBone(node, bone);
+				else
+					context.statistics.unmatchedBoneCount ++;
+				
+				context.boneNodes.push_back(node);
+				context.boneParents.push_back(layout->GetParent(bone));
+				context.boneNames.push_back(layout->GetBoneName(bone));
+			}
+			
+			context.statistics.boneCount = layout->GetBoneCount();
+			context.statistics.sceneNodeCount = index.GetNodeCount();
+			context.statistics.skeletonTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			
+			//Libraries load in the background while the skeletons sharing the layout update, so only the layout is touched here.
+			//Skeletons pick the new animations up through SkeletonLayout::SyncAnimations() on their own thread.
+			LoadAnimations(scene, index, layout, context);
+			
+			if(context.skinnedBounds)
+				CreateClipBounds(scene, index, layout, context);
+		}
+		
+		void AssimpResourceLoader::LoadAnimations(const aiScene *scene, const SceneIndex &index, SkeletonLayout *layout, LoadContext &context)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			NameTable *names = NameTable::GetSharedInstance();
+			
+			//Ranges share the clip map with the takes, a range named like a take would hide it
+			std::set<std::string> takes;
+			for(int i = 0; i < scene->mNumAnimations; i++)
+				takes.insert(scene->mAnimations[i]->mName.C_Str());
+			
 			for(int i = 0; i < scene->mNumAnimations; i++)
 			{
 				aiAnimation *aianimation = scene->mAnimations[i];
 				if(Math::Compare(aianimation->mDuration, 0.0))
 					continue;
 				
-				std::string animname(aianimation->mName.C_Str());
-				Animation *anim = new Animation(animname);
-				anim->Autorelease();
-				anim->Retain();
-				skeleton->animations.insert(std::pair<std::string, Animation*>(animname, anim));
+				NameID animname = names->GetID(aianimation->mName.data, aianimation->mName.length);
 				
-				for(int n = 0; n < aianimation->mNumChannels; n++)
+				//Clips and animations already in the layout may be playing on the skeletons sharing it, so a library can't replace either side of them
+				if(layout->FindClip(animname) || layout->FindAnimation(animname))
 				{
-					aiNodeAnim *ainodeanim = aianimation->mChannels[n];
+					context.statistics.duplicateAnimationCount ++;
+					continue;
+				}
+				
+				double duration = aianimation->mDuration / GetTicksPerSecond(aianimation);
+				bool streamed = (context.streamDuration > k::EpsilonFloat && duration >= context.streamDuration);
+				
+				//Streamed and lazy clips exist to keep the keys out of memory, so they don't get a resident engine Animation
+				if(context.animationKeyframes && !streamed && !context.lazyAnimations)
+				{
+					Animation *anim = CreateAnimation(aianimation, index, context);
 					
-					float currtime = std::numeric_limits<float>::max();
-					float starttime = 0.0f;
-					size_t currPosKey = 0;
-					size_t currRotKey = 0;
-					size_t currScalKey = 0;
+					layout->AddAnimation(animname, anim);
+					anim->Release();
+				}
+				
+				if(streamed)
+				{
+					StreamedClip *clip = CreateStreamedClip(aianimation, index, context);
+					layout->AddClip(clip);
+					clip->Release();
+				}
+				else if(context.lazyAnimations)
+				{
+					LazyClip *clip = CreateLazyClip(aianimation, index, layout, context);
+					layout->AddClip(clip);
+					clip->Release();
+				}
+				else if(context.animationChannels)
+				{
+					KeyframeClip *clip = CreateKeyframeClip(aianimation, index, context);
+					layout->AddClip(clip);
 					
-					//Matrix aiinvskinningmatrix = localskinningmatrices[std::distance(aibonenodes.begin(), std::find(aibonenodes.begin(), aibonenodes.end(), scene->mRootNode->FindNode(ainodeanim->mNodeName)))];
+					context.statistics.clipCount ++;
+					context.statistics.clipBytes += clip->GetMemorySize();
+					context.statistics.channelKeyCount += clip->GetKeyCount();
 					
-					//find first frame time
-					if(ainodeanim->mNumPositionKeys > 0)
-						currtime = fminf(ainodeanim->mPositionKeys[0].mTime, currtime);
-					if(ainodeanim->mNumRotationKeys > 0)
-						currtime = fminf(ainodeanim->mRotationKeys[0].mTime, currtime);
-					if(ainodeanim->mNumScalingKeys > 0)
-						currtime = fminf(ainodeanim->mScalingKeys[0].mTime, currtime);
+					clip->Release();
+				}
+				else if(context.animationSampleRate > k::EpsilonFloat)
+				{
+					AnimationClip *clip = CreateAnimationClip(aianimation, index, context);
+					CompressedClip *compressed = nullptr;
+					
+					context.statistics.clipCount ++;
+					context.statistics.clipBytes += clip->GetMemorySize();
 					
-					starttime = currtime;
+					if(context.compressAnimations)
+						compressed = AnimationCompressor(layout, context.compression).Compress(clip);
 					
-					AnimationBone *animbone = 0;
-					while(1)
+					if(compressed)
 					{
-						aiVector3D aipos = ainodeanim->mPositionKeys[currPosKey].mValue;
-						Vector3 animbonepos(aipos.x, aipos.y, aipos.z);
-						aiVector3D aiscal = ainodeanim->mScalingKeys[currScalKey].mValue;
-						Vector3 animbonescale(aiscal.x, aiscal.y, aiscal.z);
-						aiQuaternion airot = ainodeanim->mRotationKeys[currRotKey].mValue;
-						Quaternion animbonerot(airot.x, airot.y, airot.z, airot.w);
+						layout->AddClip(compressed);
 						
+						context.statistics.compressedClipCount ++;
+						context.statistics.compressedClipBytes += compressed->GetMemorySize();
+						context.statistics.compressedKeyCount += compressed->GetKeyCount();
 						
-						//Do blending for other key frames
-						if(ainodeanim->mNumPositionKeys > currPosKey+1)
-						{
-							aiVector3D ainextpos = ainodeanim->mPositionKeys[currPosKey+1].mValue;
-							float currframetime = ainodeanim->mPositionKeys[currPosKey].mTime;
-							float nextframetime = ainodeanim->mPositionKeys[currPosKey+1].mTime;
-							float factor = (currtime-currframetime)/(nextframetime-currframetime);
-							animbonepos = animbonepos.GetLerp(Vector3(ainextpos.x, ainextpos.y, ainextpos.z), factor);
-						}
-						if(ainodeanim->mNumScalingKeys > currScalKey+1)
-						{
-							aiVector3D ainextscal = ainodeanim->mScalingKeys[currScalKey+1].mValue;
-							float currframetime = ainodeanim->mScalingKeys[currScalKey].mTime;
-							float nextframetime = ainodeanim->mScalingKeys[currScalKey+1].mTime;
-							float factor = (currtime-currframetime)/(nextframetime-currframetime);
-							animbonescale = animbonescale.GetLerp(Vector3(ainextscal.x, ainextscal.y, ainextscal.z), factor);
-						}
-						if(ainodeanim->mNumRotationKeys > currRotKey+1)
-						{
-							aiQuaternion ainextrot = ainodeanim->mRotationKeys[currRotKey+1].mValue;
-							float currframetime = ainodeanim->mRotationKeys[currRotKey].mTime;
-							float nextframetime = ainodeanim->mRotationKeys[currRotKey+1].mTime;
-							float factor = (currtime-currframetime)/(nextframetime-currframetime);
-							animbonerot = animbonerot.GetLerpSpherical(Quaternion(ainextrot.x, ainextrot.y, ainextrot.z, ainextrot.w), factor);
-						}
+						compressed->Release();
+					}
+					else
+					{
+						layout->AddClip(clip);
+					}
+					
+					//Lower rate variants for distant characters reuse the converted full rate keys
+					for(size_t level = 0; level < context.animationLODRates.size(); level++)
+					{
+						AnimationClip *variant = clip->Resample(context.animationLODRates[level]);
+						CompressedClip *reduced = AnimationCompressor(layout, context.compression).Compress(variant);
 						
-						//Create keyframe
-						animbone = new AnimationBone(animbone, 0, currtime-starttime, animbonepos, animbonescale, animbonerot);
+						Clip *result = reduced ? static_cast<Clip *>(reduced) : variant;
+						layout->AddClipVariant(result, level + 1);
 						
-						if(ainodeanim->mNumPositionKeys == currPosKey+1 && ainodeanim->mNumRotationKeys == currRotKey+1 && ainodeanim->mNumScalingKeys == currScalKey+1)
-							break;
+						context.statistics.variantClipCount ++;
+						context.statistics.variantClipBytes += result->GetMemorySize();
 						
-						currtime = std::numeric_limits<float>::max();
-						if(ainodeanim->mNumPositionKeys > currPosKey+1)
-							currtime = fminf(ainodeanim->mPositionKeys[currPosKey+1].mTime, currtime);
-						if(ainodeanim->mNumRotationKeys > currRotKey+1)
-							currtime = fminf(ainodeanim->mRotationKeys[currRotKey+1].mTime, currtime);
-						if(ainodeanim->mNumScalingKeys > currScalKey+1)
-							currtime = fminf(ainodeanim->mScalingKeys[currScalKey+1].mTime, currtime);
+						if(reduced)
+							reduced->Release();
 						
-						if(ainodeanim->mNumPositionKeys > currPosKey+1)
-							if(Math::Compare(currtime, static_cast<float>(ainodeanim->mPositionKeys[currPosKey+1].mTime)))
-								currPosKey += 1;
-						if(ainodeanim->mNumRotationKeys > currRotKey+1)
-							if(Math::Compare(currtime, static_cast<float>(ainodeanim->mRotationKeys[currRotKey+1].mTime)))
-								currRotKey += 1;
-						if(ainodeanim->mNumScalingKeys > currScalKey+1)
-							if(Math::Compare(currtime, static_cast<float>(ainodeanim->mScalingKeys[currScalKey+1].mTime)))
-								currScalKey += 1;
+						variant->Release();
 					}
 					
-					AnimationBone *lastbone = animbone;
-					while(animbone->prevFrame != 0)
+					clip->Release();
+				}
+				
+				//Named ranges of the take reference the keys of the clip built above
+				Clip *source = layout->FindClip(animname);
+				
+				for(const AnimationRange &range : context.animationRanges)
+				{
+					if(!source || range.animation != aianimation->mName.C_Str())
+						continue;
+					
+					if(takes.find(range.name) != takes.end())
 					{
-						animbone->prevFrame->nextFrame = animbone;
-						animbone = animbone->prevFrame;
+						RNWarning("Skipping animation range " << range.name << ", a take of that name exists");
+						continue;
 					}
-					animbone->prevFrame = lastbone;
-					lastbone->nextFrame = animbone;
 					
-					auto aichild = std::find(aibonenodes.begin(), aibonenodes.end(), scene->mRootNode->FindNode(ainodeanim->mNodeName));
-					while(aichild != aibonenodes.end())
+					ClipRange *clip = new ClipRange(names->GetID(range.name), source, range.start, range.end);
+					bool added = layout->AddClip(clip);
+					clip->Release();
+					
+					if(!added)
 					{
-						size_t boneid = std::distance(aibonenodes.begin(), aichild);
+						RNWarning("Skipping animation range " << range.name << ", a clip of that name exists");
+						continue;
+					}
+					
+					context.statistics.rangeClipCount ++;
+				}
+				
+				if(context.paletteAnimations.find(aianimation->mName.C_Str()) != context.paletteAnimations.end())
+				{
+					SkinningPalette *palette = CreateSkinningPalette(aianimation, index, layout, context);
+					layout->AddPalette(palette);
+					palette->Release();
+				}
+			}
+			
+			context.statistics.animationTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		Animation *AssimpResourceLoader::CreateAnimation(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context)
+		{
+			Animation *anim = new Animation(std::string(aianimation->mName.C_Str()));
+			
+			for(int n = 0; n < aianimation->mNumChannels; n++)
+			{
+				aiNodeAnim *ainodeanim = aianimation->mChannels[n];
+				
+				float currtime = std::numeric_limits<float>::max();
+				float starttime = 0.0f;
+				size_t currPosKey = 0;
+				size_t currRotKey = 0;
+				size_t currScalKey = 0;
+				
+				//Matrix aiinvskinningmatrix = localskinningmatrices[std::distance(aibonenodes.begin(), std::find(aibonenodes.begin(), aibonenodes.end(), scene->mRootNode->FindNode(ainodeanim->mNodeName)))];
+				
+				//find first frame time
+				if(ainodeanim->mNumPositionKeys > 0)
+					currtime = fminf(ainodeanim->mPositionKeys[0].mTime, currtime);
+				if(ainodeanim->mNumRotationKeys > 0)
+					currtime = fminf(ainodeanim->mRotationKeys[0].mTime, currtime);
+				if(ainodeanim->mNumScalingKeys > 0)
+					currtime = fminf(ainodeanim->mScalingKeys[0].mTime, currtime);
+				
+				starttime = currtime;
+				
+				AnimationBone *animbone = 0;
+				while(1)
+				{
+					aiVector3D aipos = ainodeanim->mPositionKeys[currPosKey].mValue;
+					Vector3 animbonepos(aipos.x, aipos.y, aipos.z);
+					aiVector3D aiscal = ainodeanim->mScalingKeys[currScalKey].mValue;
+					Vector3 animbonescale(aiscal.x, aiscal.y, aiscal.z);
+					aiQuaternion airot = ainodeanim->mRotationKeys[currRotKey].mValue;
+					Quaternion animbonerot(airot.x, airot.y, airot.z, airot.w);
+					
+					
+					//Do blending for other key frames
+					if(ainodeanim->mNumPositionKeys > currPosKey+1)
+					{
+						aiVector3D ainextpos = ainodeanim->mPositionKeys[currPosKey+1].mValue;
+						float currframetime = ainodeanim->mPositionKeys[currPosKey].mTime;
+						float nextframetime = ainodeanim->mPositionKeys[currPosKey+1].mTime;
+						float factor = (currtime-currframetime)/(nextframetime-currframetime);
+						animbonepos = animbonepos.GetLerp(Vector3(ainextpos.x, ainextpos.y, ainextpos.z), factor);
+					}
+					if(ainodeanim->mNumScalingKeys > currScalKey+1)
+					{
+						aiVector3D ainextscal = ainodeanim->mScalingKeys[currScalKey+1].mValue;
+						float currframetime = ainodeanim->mScalingKeys[currScalKey].mTime;
+						float nextframetime = ainodeanim->mScalingKeys[currScalKey+1].mTime;
+						float factor = (currtime-currframetime)/(nextframetime-currframetime);
+						animbonescale = animbonescale.GetLerp(Vector3(ainextscal.x, ainextscal.y, ainextscal.z), factor);
+					}
+					if(ainodeanim->mNumRotationKeys > currRotKey+1)
+					{
+						aiQuaternion ainextrot = ainodeanim->mRotationKeys[currRotKey+1].mValue;
+						float currframetime = ainodeanim->mRotationKeys[currRotKey].mTime;
+						float nextframetime = ainodeanim->mRotationKeys[currRotKey+1].mTime;
+						float factor = (currtime-currframetime)/(nextframetime-currframetime);
+						animbonerot = animbonerot.GetLerpSpherical(Quaternion(ainextrot.x, ainextrot.y, ainextrot.z, ainextrot.w), factor);
+					}
+					
+					//Create keyframe
+					animbone = new AnimationBone(animbone, 0, currtime-starttime, animbonepos, animbonescale, animbonerot);
+					context.statistics.keyframeCount ++;
+					
+					if(ainodeanim->mNumPositionKeys == currPosKey+1 && ainodeanim->mNumRotationKeys == currRotKey+1 && ainodeanim->mNumScalingKeys == currScalKey+1)
+						break;
+					
+					currtime = std::numeric_limits<float>::max();
+					if(ainodeanim->mNumPositionKeys > currPosKey+1)
+						currtime = fminf(ainodeanim->mPositionKeys[currPosKey+1].mTime, currtime);
+					if(ainodeanim->mNumRotationKeys > currRotKey+1)
+						currtime = fminf(ainodeanim->mRotationKeys[currRotKey+1].mTime, currtime);
+					if(ainodeanim->mNumScalingKeys > currScalKey+1)
+						currtime = fminf(ainodeanim->mScalingKeys[currScalKey+1].mTime, currtime);
+					
+					if(ainodeanim->mNumPositionKeys > currPosKey+1)
+						if(Math::Compare(currtime, static_cast<float>(ainodeanim->mPositionKeys[currPosKey+1].mTime)))
+							currPosKey += 1;
+					if(ainodeanim->mNumRotationKeys > currRotKey+1)
+						if(Math::Compare(currtime, static_cast<float>(ainodeanim->mRotationKeys[currRotKey+1].mTime)))
+							currRotKey += 1;
+					if(ainodeanim->mNumScalingKeys > currScalKey+1)
+						if(Math::Compare(currtime, static_cast<float>(ainodeanim->mScalingKeys[currScalKey+1].mTime)))
+							currScalKey += 1;
+				}
+				
+				AnimationBone *lastbone = animbone;
+				while(animbone->prevFrame != 0)
+				{
+					animbone->prevFrame->nextFrame = animbone;
+					animbone = animbone->prevFrame;
+				}
+				animbone->prevFrame = lastbone;
+				lastbone->nextFrame = animbone;
+				
+				size_t node = index.FindNode(ainodeanim->mNodeName);
+				if(node != SceneIndex::InvalidIndex)
+				{
+					for(size_t boneid : index.GetNode(node).bones)
 						anim->bones.insert(std::pair<size_t, AnimationBone*>(boneid, animbone));
-						aichild = std::find(++aichild, aibonenodes.end(), scene->mRootNode->FindNode(ainodeanim->mNodeName));
+				}
+			}
+			
+			//Fixed up before the animation is added to the layout, where skeletons may already pick it up
+			if(anim->GetLength() <= k::EpsilonFloat)
+			{
+				for(auto bone : anim->bones)
+				{
+					float time = 0.0f;
+					AnimationBone *first = bone.second;
+					AnimationBone *temp = bone.second;
+					while(temp != nullptr && temp != first)
+					{
+						temp->time = time;
+						time += 1.0f;
+						temp = temp->nextFrame;
 					}
 				}
 			}
 			
-			for(auto anim : skeleton->animations)
+			return anim;
+		}
+		
+		template<class Value>
+		static void InterpolateKey(Value &result, const Value &from, const Value &to, float factor)
+		{
+			result = from + (to - from) * factor;
+		}
+		
+		template<>
+		void InterpolateKey<aiQuaternion>(aiQuaternion &result, const aiQuaternion &from, const aiQuaternion &to, float factor)
+		{
+			aiQuaternion::Interpolate(result, from, to, factor);
+		}
+		
+		template<class Key>
+		static decltype(Key::mValue) SampleKeys(const Key *keys, unsigned int count, double time, unsigned int &cursor)
+		{
+			// Sample times only increase, the cursor remembers the last key so resampling a channel stays linear
+			while(cursor + 1 < count && keys[cursor + 1].mTime <= time)
+				cursor ++;
+			
+			if(cursor + 1 >= count || time <= keys[cursor].mTime)
+				return keys[cursor].mValue;
+			
+			decltype(Key::mValue) result;
+			float factor = static_cast<float>((time - keys[cursor].mTime) / (keys[cursor + 1].mTime - keys[cursor].mTime));
+			InterpolateKey(result, keys[cursor].mValue, keys[cursor + 1].mValue, factor);
+			
+			return result;
+		}
+		
+		static void GetBindPose(const SceneIndex &index, size_t node, aiVector3D &scale, aiQuaternion &rotation, aiVector3D &position)
+		{
+			// Bones missing from an animation library's hierarchy stay at the identity
+			if(node == SceneIndex::InvalidIndex)
+			{
+				scale = aiVector3D(1.0f, 1.0f, 1.0f);
+				rotation = aiQuaternion();
+				position = aiVector3D();
+				return;
+			}
+			
+			index.GetNode(node).node->mTransformation.Decompose(scale, rotation, position);
+		}
+		
+		static std::vector<aiNodeAnim *> GetBoneChannels(aiAnimation *aianimation, const SceneIndex &index, size_t bonecount)
+		{
+			std::vector<aiNodeAnim *> channels(bonecount, nullptr);
+			for(unsigned int i = 0; i < aianimation->mNumChannels; i++)
 			{
-				if(anim.second->GetLength() <= k::EpsilonFloat)
+				size_t node = index.FindNode(aianimation->mChannels[i]->mNodeName);
+				if(node != SceneIndex::InvalidIndex && !index.GetNode(node).bones.empty())
+					channels[index.GetNode(node).bones.front()] = aianimation->mChannels[i];
+			}
+			
+			return channels;
+		}
+		
+		AnimationClip *AssimpResourceLoader::CreateAnimationClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context)
+		{
+			double ticksPerSecond = GetTicksPerSecond(aianimation);
+			double duration = aianimation->mDuration / ticksPerSecond;
+			
+			size_t bonecount = context.boneNodes.size();
+			
+			NameID name = NameTable::GetSharedInstance()->GetID(aianimation->mName.data, aianimation->mName.length);
+			AnimationClip *clip = new AnimationClip(name, bonecount, static_cast<float>(duration), context.animationSampleRate);
+			size_t framecount = clip->GetFrameCount();
+			
+			std::vector<aiNodeAnim *> channels = GetBoneChannels(aianimation, index, bonecount);
+			
+			for(size_t bone = 0; bone < bonecount; bone++)
+			{
+				float *positions = clip->GetPositions(bone);
+				float *rotations = clip->GetRotations(bone);
+				float *scales = clip->GetScales(bone);
+				
+				aiNodeAnim *channel = channels[bone];
+				unsigned int positionkey = 0;
+				unsigned int rotationkey = 0;
+				unsigned int scalekey = 0;
+				
+				aiVector3D position;
+				aiQuaternion rotation;
+				aiVector3D scale;
+				
+				//Bones without a channel hold their bind pose
+				if(!channel)
+					GetBindPose(index, context.boneNodes[bone], scale, rotation, position);
+				
+				for(size_t frame = 0; frame < framecount; frame++)
 				{
-					for(auto bone : anim.second->bones)
+					if(channel)
 					{
-						float time = 0.0f;
-						AnimationBone *first = bone.second;
-						AnimationBone *temp = bone.second;
-						while(temp != nullptr && temp != first)
-						{
-							temp->time = time;
-							time += 1.0f;
-							temp = temp->nextFrame;
-						}
+						double time = std::min(frame / static_cast<double>(context.animationSampleRate), duration) * ticksPerSecond;
+						
+						position = SampleKeys(channel->mPositionKeys, channel->mNumPositionKeys, time, positionkey);
+						rotation = SampleKeys(channel->mRotationKeys, channel->mNumRotationKeys, time, rotationkey);
+						scale = SampleKeys(channel->mScalingKeys, channel->mNumScalingKeys, time, scalekey);
 					}
+					
+					positions[frame * 3 + 0] = position.x;
+					positions[frame * 3 + 1] = position.y;
+					positions[frame * 3 + 2] = position.z;
+					
+					rotations[frame * 4 + 0] = rotation.x;
+					rotations[frame * 4 + 1] = rotation.y;
+					rotations[frame * 4 + 2] = rotation.z;
+					rotations[frame * 4 + 3] = rotation.w;
+					
+					scales[frame * 3 + 0] = scale.x;
+					scales[frame * 3 + 1] = scale.y;
+					scales[frame * 3 + 2] = scale.z;
 				}
 			}
 			
-			model->SetSkeleton(skeleton);
+			return clip;
+		}
+		
+		static void AppendKeyValue(std::vector<float> &values, const aiVector3D &value)
+		{
+			values.push_back(value.x);
+			values.push_back(value.y);
+			values.push_back(value.z);
+		}
+		
+		static void AppendKeyValue(std::vector<float> &values, const aiQuaternion &value)
+		{
+			values.push_back(value.x);
+			values.push_back(value.y);
+			values.push_back(value.z);
+			values.push_back(value.w);
+		}
+		
+		template<class Key>
+		static void ConvertKeys(const Key *keys, unsigned int count, double ticksPerSecond, std::vector<float> &times, std::vector<float> &values)
+		{
+			times.clear();
+			values.clear();
+			
+			for(unsigned int i = 0; i < count; i++)
+			{
+				times.push_back(static_cast<float>(keys[i].mTime / ticksPerSecond));
+				AppendKeyValue(values, keys[i].mValue);
+			}
+		}
+		
+		KeyframeClip *AssimpResourceLoader::CreateKeyframeClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context)
+		{
+			double ticksPerSecond = GetTicksPerSecond(aianimation);
+			size_t bonecount = context.boneNodes.size();
+			
+			NameID name = NameTable::GetSharedInstance()->GetID(aianimation->mName.data, aianimation->mName.length);
+			KeyframeClip *clip = new KeyframeClip(name, bonecount, static_cast<float>(aianimation->mDuration / ticksPerSecond));
+			
+			std::vector<aiNodeAnim *> channels = GetBoneChannels(aianimation, index, bonecount);
+			std::vector<float> times;
+			std::vector<float> values;
+			
+			for(size_t bone = 0; bone < bonecount; bone++)
+			{
+				aiNodeAnim *channel = channels[bone];
+				
+				//Bones without a channel hold their bind pose
+				if(!channel)
+				{
+					aiVector3D position;
+					aiQuaternion rotation;
+					aiVector3D scale;
+					GetBindPose(index, context.boneNodes[bone], scale, rotation, position);
+					
+					float time = 0.0f;
+					values.clear();
+					AppendKeyValue(values, position);
+					clip->SetPositionKeys(bone, &time, values.data(), 1);
+					
+					values.clear();
+					AppendKeyValue(values, rotation);
+					clip->SetRotationKeys(bone, &time, values.data(), 1);
+					
+					values.clear();
+					AppendKeyValue(values, scale);
+					clip->SetScaleKeys(bone, &time, values.data(), 1);
+					continue;
+				}
+				
+				ConvertKeys(channel->mPositionKeys, channel->mNumPositionKeys, ticksPerSecond, times, values);
+				clip->SetPositionKeys(bone, times.data(), values.data(), times.size());
+				
+				ConvertKeys(channel->mRotationKeys, channel->mNumRotationKeys, ticksPerSecond, times, values);
+				clip->SetRotationKeys(bone, times.data(), values.data(), times.size());
+				
+				ConvertKeys(channel->mScalingKeys, channel->mNumScalingKeys, ticksPerSecond, times, values);
+				clip->SetScaleKeys(bone, times.data(), values.data(), times.size());
+			}
+			
+			return clip;
+		}
+		
+		std::string AssimpResourceLoader::GetClipCachePath(aiAnimation *aianimation, const std::string &prefix, LoadContext &context, uint64 settings)
+		{
+			// The baked keys are keyed by the source contents and the rig the channels were mapped to, so any edit
+			// to the file or a renamed or reordered bone bakes them again. Hashed once per load.
+			if(context.sourceHash == 0)
+			{
+				NameTable *names = NameTable::GetSharedInstance();
+				
+				uint64 hash = HashFileContents(context.sourcepath, HashBytes(context.sourcepath.data(), context.sourcepath.length() + 1));
+				
+				for(size_t i = 0; i < context.boneNames.size(); i++)
+				{
+					const std::string &name = names->GetName(context.boneNames[i]);
+					
+					hash = HashBytes(name.data(), name.length() + 1, hash);
+					hash = HashBytes(&context.boneParents[i], sizeof(int32), hash);
+				}
+				
+				context.sourceHash = std::max<uint64>(hash, 1);
+			}
+			
+			uint64 hash = HashBytes(aianimation->mName.data, aianimation->mName.length, context.sourceHash);
+			hash = HashBytes(&settings, sizeof(settings), hash);
+			
+			std::stringstream name;
+			name << prefix << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+			
+			return PathManager::Join(context.cachepath, name.str());
+		}
+		
+		StreamedClip *AssimpResourceLoader::CreateStreamedClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context)
+		{
+			size_t blockframes = std::max<size_t>(static_cast<size_t>(context.streamBlockDuration * context.animationSampleRate), 1);
+			
+			uint64 settings = HashBytes(&context.animationSampleRate, sizeof(context.animationSampleRate));
+			settings = HashBytes(&blockframes, sizeof(blockframes), settings);
+			
+			std::string path = GetClipCachePath(aianimation, "stream", context, settings);
+			
+			if(!StreamedClip::IsValidFile(path, context.boneNodes.size()))
+			{
+				AnimationClip *clip = CreateAnimationClip(aianimation, index, context);
+				
+				PathManager::CreatePath(context.cachepath);
+				StreamedClip::WriteToFile(path, clip, blockframes);
+				clip->Release();
+				
+				context.statistics.bakedClipCount ++;
+			}
+			
+			context.statistics.streamedClipCount ++;
+			
+			NameID name = NameTable::GetSharedInstance()->GetID(aianimation->mName.data, aianimation->mName.length);
+			return new StreamedClip(name, path, context.streamWindowBlocks);
+		}
+		
+		SkinningPalette *AssimpResourceLoader::CreateSkinningPalette(aiAnimation *aianimation, const SceneIndex &index, const SkeletonLayout *layout, LoadContext &context)
+		{
+			// The bind pose comes from the skeleton, which isn't necessarily from this file for animation libraries
+			uint64 settings = HashBytes(&context.paletteSampleRate, sizeof(context.paletteSampleRate));
+			settings = HashBytes(&context.paletteHalfFloat, sizeof(context.paletteHalfFloat), settings);
+			
+			for(size_t bone = 0; bone < layout->GetBoneCount(); bone++)
+				settings = HashBytes(layout->GetBoneOffset(bone).m, sizeof(Matrix::m), settings);
+			
+			std::string path = GetClipCachePath(aianimation, "palette", context, settings);
+			
+			NameID name = NameTable::GetSharedInstance()->GetID(aianimation->mName.data, aianimation->mName.length);
+			float duration = static_cast<float>(aianimation->mDuration / GetTicksPerSecond(aianimation));
+			
+			SkinningPalette *palette = new SkinningPalette(name, layout->GetBoneCount(), duration, context.paletteSampleRate, context.paletteHalfFloat);
+			
+			if(!palette->ReadFromFile(path))
+			{
+				palette->Release();
+				
+				// Sample the clip the skeleton already has. The keyframe only mode needs a temporary one, and so do streamed
+				// clips, whose shared window would otherwise keep the blocks of one off sampling resident.
+				Clip *clip = layout->FindClip(name);
+				KeyframeClip *keys = nullptr;
+				
+				if(!clip || dynamic_cast<StreamedClip *>(clip))
+				{
+					keys = CreateKeyframeClip(aianimation, index, context);
+					clip = keys;
+				}
+				
+				LazyClip *lazy = dynamic_cast<LazyClip *>(clip);
+				bool resident = lazy && lazy->IsResident();
+				
+				palette = SkinningPalette::Bake(clip, layout, duration, context.paletteSampleRate, context.paletteHalfFloat);
+				
+				if(keys)
+					keys->Release();
+				
+				// Baking shouldn't leave lazy clips decoded that nothing played yet
+				if(lazy && !resident)
+					lazy->Evict(0.0f);
+				
+				PathManager::CreatePath(context.cachepath);
+				palette->WriteToFile(path);
+				
+				context.statistics.bakedClipCount ++;
+			}
+			
+			context.statistics.paletteCount ++;
+			context.statistics.paletteBytes += palette->GetMemorySize();
+			
+			return palette;
+		}
+		
+		void AssimpResourceLoader::CreateBoneBounds(const aiScene *scene, SkeletonLayout *layout, LoadContext &context)
+		{
+			NameTable *names = NameTable::GetSharedInstance();
+			
+			for(int i = 0; i < scene->mNumMeshes; i++)
+			{
+				aiMesh *aimesh = scene->mMeshes[i];
+				for(int b = 0; b < aimesh->mNumBones; b++)
+				{
+					aiBone *aibone = aimesh->mBones[b];
+					
+					auto iterator = context.boneIndices.find(names->FindID(aibone->mName.data, aibone->mName.length));
+					if(iterator == context.boneIndices.end())
+						continue;
+					
+					//The offset matrix moves the bind pose vertices into bone space, where the box stays fixed while the bone animates
+					aiVector3D minimum(std::numeric_limits<float>::max());
+					aiVector3D maximum(-std::numeric_limits<float>::max());
+					bool empty = true;
+					
+					for(int w = 0; w < aibone->mNumWeights; w++)
+					{
+						const aiVertexWeight &aiweight = aibone->mWeights[w];
+						if(aiweight.mWeight <= context.skinnedBoundsWeight)
+							continue;
+						
+						aiVector3D position = aibone->mOffsetMatrix * aimesh->mVertices[aiweight.mVertexId];
+						
+						minimum = aiVector3D(std::min(minimum.x, position.x), std::min(minimum.y, position.y), std::min(minimum.z, position.z));
+						maximum = aiVector3D(std::max(maximum.x, position.x), std::max(maximum.y, position.y), std::max(maximum.z, position.z));
+						empty = false;
+					}
+					
+					if(empty)
+						continue;
+					
+					if(layout->AddBoneBounds(iterator->second, AABB(Vector3(minimum.x, minimum.y, minimum.z), Vector3(maximum.x, maximum.y, maximum.z))))
+						context.statistics.boundedBoneCount ++;
+				}
+			}
+		}
+		
+		static bool ReadClipBounds(const std::string &path, Vector3 &minimum, Vector3 &maximum)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			if(!stream.is_open())
+				return false;
+			
+			uint32 header[2];
+			float values[6];
+			
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			stream.read(reinterpret_cast<char *>(values), sizeof(values));
+			
+			if(!stream.good() || header[0] != kRAClipBoundsMagic || header[1] != kRAClipBoundsVersion)
+				return false;
+			
+			minimum = Vector3(values[0], values[1], values[2]);
+			maximum = Vector3(values[3], values[4], values[5]);
+			
+			return true;
+		}
+		
+		static bool WriteClipBounds(const std::string &path, const Vector3 &minimum, const Vector3 &maximum)
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			uint32 header[2] = { kRAClipBoundsMagic, kRAClipBoundsVersion };
+			float values[6] = { minimum.x, minimum.y, minimum.z, maximum.x, maximum.y, maximum.z };
+			
+			stream.write(reinterpret_cast<const char *>(header), sizeof(header));
+			stream.write(reinterpret_cast<const char *>(values), sizeof(values));
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				return false;
+			}
+			
+			std::remove(path.c_str());
+			return (std::rename(temporary.c_str(), path.c_str()) == 0);
+		}
+		
+		void AssimpResourceLoader::CreateClipBounds(const aiScene *scene, const SceneIndex &index, SkeletonLayout *layout, LoadContext &context)
+		{
+			if(!layout->HasBounds())
+				return;
+			
+			NameTable *names = NameTable::GetSharedInstance();
+			size_t bonecount = layout->GetBoneCount();
+			
+			// The clip bounds depend on the bone boxes, which shared layouts merge from every model using them
+			uint64 settings = HashBytes(&context.skinnedBoundsRate, sizeof(context.skinnedBoundsRate));
+			
+			for(size_t bone = 0; bone < bonecount; bone++)
+			{
+				if(!layout->HasBoneBounds(bone))
+					continue;
+				
+				AABB bounds = layout->GetBoneBounds(bone);
+				Vector3 minimum = bounds.position + bounds.minExtend;
+				Vector3 maximum = bounds.position + bounds.maxExtend;
+				
+				float values[7] = { static_cast<float>(bone), minimum.x, minimum.y, minimum.z, maximum.x, maximum.y, maximum.z };
+				
+				settings = HashBytes(values, sizeof(values), settings);
+			}
+			
+			std::vector<Vector3> positions(bonecount);
+			std::vector<Quaternion> rotations(bonecount);
+			std::vector<Vector3> scales(bonecount);
+			
+			std::vector<Matrix> local(bonecount);
+			std::vector<Matrix> global(bonecount);
+			
+			for(int i = 0; i < scene->mNumAnimations; i++)
+			{
+				aiAnimation *aianimation = scene->mAnimations[i];
+				if(Math::Compare(aianimation->mDuration, 0.0))
+					continue;
+				
+				NameID name = names->GetID(aianimation->mName.data, aianimation->mName.length);
+				std::string path = GetClipCachePath(aianimation, "bounds", context, settings);
+				
+				Vector3 minimum;
+				Vector3 maximum;
+				
+				if(ReadClipBounds(path, minimum, maximum))
+				{
+					layout->SetClipBounds(name, AABB(minimum, maximum));
+					context.statistics.clipBoundsCount ++;
+					
+					continue;
+				}
+				
+				// Samples the clip the layout already holds, only the keyframe only mode needs a temporary one
+				Clip *clip = layout->FindClip(name);
+				KeyframeClip *keys = nullptr;
+				
+				if(!clip)
+				{
+					keys = CreateKeyframeClip(aianimation, index, context);
+					clip = keys;
+				}
+				
+				LazyClip *lazy = dynamic_cast<LazyClip *>(clip);
+				bool resident = lazy && lazy->IsResident();
+				
+				// Streamed clips are read through a cursor of our own, its blocks go away with it
+				StreamCursor *cursor = StreamCursor::CreateForClip(clip);
+				
+				// The last sample lands just before the end, sampling the duration itself wraps back to the first pose
+				float duration = static_cast<float>(aianimation->mDuration / GetTicksPerSecond(aianimation));
+				size_t framecount = static_cast<size_t>(std::ceil(duration * context.skinnedBoundsRate)) + 1;
+				
+				Vector3 previousMin;
+				Vector3 previousMax;
+				Vector3 padding(0.0f, 0.0f, 0.0f);
+				
+				clip->WaitUntilResident();
+				
+				for(size_t frame = 0; frame < framecount; frame++)
+				{
+					float time = std::min(frame / context.skinnedBoundsRate, std::nextafter(duration, 0.0f));
+					
+					if(cursor)
+						cursor->Sample(time, positions.data(), rotations.data(), scales.data());
+					else
+						clip->Sample(time, positions.data(), rotations.data(), scales.data());
+					
+					for(size_t bone = 0; bone < bonecount; bone++)
+						local[bone] = Matrix::WithTranslation(positions[bone]) * Matrix::WithRotation(rotations[bone]) * Matrix::WithScaling(scales[bone]);
+					
+					layout->ComputeGlobalMatrices(local.data(), global.data());
+					
+					AABB bounds = layout->TransformBounds(global.data());
+					Vector3 poseMin = bounds.position + bounds.minExtend;
+					Vector3 poseMax = bounds.position + bounds.maxExtend;
+					
+					if(frame == 0)
+					{
+						minimum = poseMin;
+						maximum = poseMax;
+					}
+					else
+					{
+						minimum = Vector3(std::min(minimum.x, poseMin.x), std::min(minimum.y, poseMin.y), std::min(minimum.z, poseMin.z));
+						maximum = Vector3(std::max(maximum.x, poseMax.x), std::max(maximum.y, poseMax.y), std::max(maximum.z, poseMax.z));
+						
+						// Half of the largest step between two samples covers the poses in between as long as the motion is smooth
+						Vector3 step(std::max(std::fabs(poseMin.x - previousMin.x), std::fabs(poseMax.x - previousMax.x)),
+									 std::max(std::fabs(poseMin.y - previousMin.y), std::fabs(poseMax.y - previousMax.y)),
+									 std::max(std::fabs(poseMin.z - previousMin.z), std::fabs(poseMax.z - previousMax.z)));
+						
+						padding = Vector3(std::max(padding.x, step.x * 0.5f), std::max(padding.y, step.y * 0.5f), std::max(padding.z, step.z * 0.5f));
+					}
+					
+					previousMin = poseMin;
+					previousMax = poseMax;
+				}
+				
+				if(keys)
+					keys->Release();
+				
+				if(cursor)
+					cursor->Release();
+				
+				// Bounds computation shouldn't leave lazy clips decoded that nothing played yet
+				if(lazy && !resident)
+					lazy->Evict(0.0f);
+				
+				minimum = minimum - padding;
+				maximum = maximum + padding;
+				
+				layout->SetClipBounds(name, AABB(minimum, maximum));
+				context.statistics.clipBoundsCount ++;
+				
+				PathManager::CreatePath(context.cachepath);
+				if(!WriteClipBounds(path, minimum, maximum))
+					RNWarning("Couldn't write clip bounds " << path);
+			}
+		}
+		
+		LazyClip *AssimpResourceLoader::CreateLazyClip(aiAnimation *aianimation, const SceneIndex &index, const SkeletonLayout *layout, LoadContext &context)
+		{
+			size_t bonecount = context.boneNodes.size();
+			std::string path = GetClipCachePath(aianimation, "clip", context);
+			
+			if(!KeyframeClip::IsValidFile(path, bonecount))
+			{
+				KeyframeClip *keys = CreateKeyframeClip(aianimation, index, context);
+				
+				PathManager::CreatePath(context.cachepath);
+				keys->WriteToFile(path);
+				keys->Release();
+				
+				context.statistics.bakedClipCount ++;
+			}
+			
+			LazyClip::Decoding decoding;
+			decoding.sampleRate = context.animationChannels ? 0.0f : context.animationSampleRate;
+			decoding.compress = context.compressAnimations;
+			decoding.compression = context.compression;
+			
+			context.statistics.lazyClipCount ++;
+			
+			NameID clipname = NameTable::GetSharedInstance()->GetID(aianimation->mName.data, aianimation->mName.length);
+			float duration = static_cast<float>(aianimation->mDuration / GetTicksPerSecond(aianimation));
+			
+			return new LazyClip(clipname, bonecount, duration, aianimation->mNumChannels, path, decoding, layout);
 		}
 		
 		bool AssimpResourceLoader::SupportsLoadingFile(File *file)
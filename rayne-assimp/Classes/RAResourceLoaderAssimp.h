@@ -22,6 +22,18 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <set>
+#include <unordered_map>
+
+#include "RATextureCache.h"
+#include "RASceneIndex.h"
+#include "RANameTable.h"
+#include "RAAnimationClip.h"
+#include "RAAnimationCompressor.h"
+#include "RAKeyframeClip.h"
+#include "RALazyClip.h"
+#include "RAClipRange.h"
+#include "RAStreamedClip.h"
 
 namespace RN
 {
@@ -42,11 +54,145 @@ namespace RN
 			static void InitialWakeUp(MetaClass *meta);
 			
 		private:
-			void LoadLODStage(const aiScene *scene, Model *model, size_t stage, const std::string &filepath, bool guessMaterial);
-			void LoadSkeleton(const aiScene *scene, Model *model);
+			struct LoadStatistics
+			{
+				LoadStatistics();
+				
+				size_t textureCount;
+				size_t embeddedTextureCount;
+				size_t atlasPageCount;
+				size_t atlasedMeshCount;
+				size_t biasedTextureCount;
+				size_t deferredTextureCount;
+				size_t preprocessedTextureCount;
+				
+				size_t boneCount;
+				size_t meshBoneCount;
+				size_t sceneNodeCount;
+				size_t unmatchedBoneCount;
+				size_t duplicateAnimationCount;
+				size_t sharedSkeletonCount;
+				double skeletonTime; // milliseconds
+				
+				size_t keyframeCount;
+				size_t clipCount;
+				size_t clipBytes;
+				double animationTime; // milliseconds
+				
+				size_t compressedClipCount;
+				size_t compressedClipBytes;
+				size_t compressedKeyCount;
+				size_t channelKeyCount;
+				
+				size_t lazyClipCount;
+				size_t bakedClipCount;
+				size_t rangeClipCount;
+				size_t streamedClipCount;
+				size_t paletteCount;
+				size_t paletteBytes;
+				size_t variantClipCount;
+				size_t variantClipBytes;
+				size_t maskedBoneCount;
+				size_t boundedBoneCount;
+				size_t clipBoundsCount;
+				
+				std::set<std::string> shaderPermutations;
+				size_t newShaderPermutationCount;
+				
+				std::map<std::string, size_t> textureVariants;
+				std::map<std::string, std::string> texturePaths;
+			};
+			
+			struct AnimationRange
+			{
+				std::string animation;
+				std::string name;
+				float start; // seconds
+				float end;
+			};
+			
+			struct LoadContext
+			{
+				std::string filepath;
+				std::string cachepath;
+				std::string sourcepath;
+				uint64 sourceHash; // Contents of the source file and the rig, 0 until the first baked clip needs it
+				bool guessMaterial;
+				
+				bool atlasTextures;
+				uint32 atlasMaxTextureSize;
+				uint32 atlasPageSize;
+				
+				bool lodMipBias; // Implies deferTextures
+				uint32 mipBias;
+				
+				bool deferTextures;
+				bool preprocessTextures;
+				
+				bool animationKeyframes;
+				bool animationChannels;
+				float animationSampleRate;
+				std::vector<float> animationLODRates;
+				bool lazyAnimations;
+				bool shareSkeletons;
+				
+				float streamDuration; // Clips at least this long are streamed, 0 disables streaming
+				float streamBlockDuration;
+				uint32 streamWindowBlocks;
+				
+				std::set<std::string> paletteAnimations;
+				float paletteSampleRate;
+				bool paletteHalfFloat;
+				
+				bool compressAnimations;
+				AnimationCompressor::Settings compression;
+				std::vector<AnimationRange> animationRanges;
+				
+				std::unordered_map<NameID, size_t> boneIndices;
+				std::vector<size_t> boneNodes;
+				std::vector<int32> boneParents;
+				std::vector<NameID> boneNames;
+				
+				bool skeletonLOD;
+				float skeletonLODWeight;
+				std::vector<std::vector<bool>> boneMasks; // Per LOD stage
+				
+				bool skinnedBounds;
+				float skinnedBoundsWeight;
+				float skinnedBoundsRate;
+				
+				LoadStatistics statistics;
+			};
+			
+			void LoadLODStage(const aiScene *scene, Model *model, size_t stage, LoadContext &context);
+			void MapBones(const aiScene *scene, SceneIndex &index, LoadContext &context);
+			void LoadSkeleton(const aiScene *scene, const SceneIndex &index, Model *model, LoadContext &context);
+			void LoadAnimationLibrary(File *file, Skeleton *skeleton, LoadContext &context);
+			uint64 HashAnimations(const aiScene *scene, const LoadContext &context, uint64 hash);
+			void LoadAnimations(const aiScene *scene, const SceneIndex &index, SkeletonLayout *layout, LoadContext &context);
+			Animation *CreateAnimation(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context);
+			AnimationClip *CreateAnimationClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context);
+			KeyframeClip *CreateKeyframeClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context);
+			StreamedClip *CreateStreamedClip(aiAnimation *aianimation, const SceneIndex &index, LoadContext &context);
+			SkinningPalette *CreateSkinningPalette(aiAnimation *aianimation, const SceneIndex &index, const SkeletonLayout *layout, LoadContext &context);
+			std::string GetClipCachePath(aiAnimation *aianimation, const std::string &prefix, LoadContext &context, uint64 settings = 0);
+			LazyClip *CreateLazyClip(aiAnimation *aianimation, const SceneIndex &index, const SkeletonLayout *layout, LoadContext &context);
+			void CreateBoneBounds(const aiScene *scene, SkeletonLayout *layout, LoadContext &context);
+			void CreateClipBounds(const aiScene *scene, const SceneIndex &index, SkeletonLayout *layout, LoadContext &context);
+			
+			void LoadAtlasedMeshes(const aiScene *scene, Model *model, size_t stage, Shader *shader, LoadContext &context, std::vector<bool> &atlased);
+			
+			Material *CreateMaterial(const aiScene *scene, aiMaterial *aimaterial, Shader *shader, LoadContext &context);
+			Mesh *CreateMesh(aiMesh *aimesh, size_t stage, const LoadContext &context);
+			std::vector<bool> ComputeBoneMask(const aiScene *scene, const LoadContext &context);
+			void RecordDefines(const std::vector<std::string> &defines, LoadContext &context);
 			
-			Texture *GetTexture(aiMaterial *aimaterial, const std::string &filepath, aiTextureType aitexturetype, uint8 index = 0);
-			void WalkForgottenBones(aiNode *ainode, std::vector<aiNode *> &ainodes);
+			void AddTexture(Material *material, const aiScene *scene, aiMaterial *aimaterial, LoadContext &context, aiTextureType aitexturetype);
+			Texture *GetTexture(const aiScene *scene, aiMaterial *aimaterial, LoadContext &context, aiTextureType aitexturetype, uint8 index = 0);
+			TextureCache::Request MakeTextureRequest(const TextureCache::ResolvedPath &resolved, aiTextureType aitexturetype, LoadContext &context);
+			void ReadAnimationRanges(const std::string &path, std::vector<AnimationRange> &ranges);
+			void WriteStatistics(const LoadStatistics &statistics, Dictionary *dictionary);
+			uint32 GetMipBias(const std::vector<float> &lodFactors, size_t stage);
 			void CopyMatrix(aiMatrix4x4 &from, Matrix &to);
 			void CopyMatrix(Matrix &from, aiMatrix4x4 &to);
 			
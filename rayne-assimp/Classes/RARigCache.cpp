@@ -0,0 +1,98 @@
+//
+//  RARigCache.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RARigCache.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: RigCache
+		// ---------------------
+		
+		RigCache::RigCache()
+		{}
+		
+		RigCache *RigCache::GetSharedInstance()
+		{
+			static RigCache *instance = new RigCache();
+			return instance;
+		}
+		
+		bool RigCache::Acquire(uint64 fingerprint, Skeleton *skeleton)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _rigs.find(fingerprint);
+			if(iterator == _rigs.end())
+				return false;
+			
+			// The skeleton is still private to the loader, so its animations can be filled right here
+			SkeletonLayout *layout = iterator->second;
+			
+			layout->SyncAnimations(skeleton);
+			SkeletonLayout::SetLayoutForSkeleton(skeleton, layout);
+			
+			return true;
+		}
+		
+		void RigCache::Add(uint64 fingerprint, SkeletonLayout *layout)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(_rigs.insert(std::make_pair(fingerprint, layout)).second)
+				layout->Retain();
+		}
+		
+		void RigCache::RemoveUnusedRig(SkeletonLayout *layout)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			// Acquire registers skeletons while holding the lock, so the count can't go up behind this check
+			if(layout->GetSkeletonCount() > 0)
+				return;
+			
+			for(auto iterator = _rigs.begin(); iterator != _rigs.end(); iterator ++)
+			{
+				if(iterator->second == layout)
+				{
+					_rigs.erase(iterator);
+					layout->Release();
+					return;
+				}
+			}
+		}
+		
+		size_t RigCache::GetRigCount()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return _rigs.size();
+		}
+		
+		void RigCache::Clear()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			for(auto &pair : _rigs)
+				pair.second->Release();
+			
+			_rigs.clear();
+		}
+	}
+}
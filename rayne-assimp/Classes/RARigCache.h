@@ -0,0 +1,59 @@
+//
+//  RARigCache.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_RIGCACHE__
+#define __RAYNE_ASSIMP_RIGCACHE__
+
+#include <Rayne/Rayne.h>
+#include "RASkeletonLayout.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Skeleton definitions shared between models with the same rig and animation set. The loader fingerprints
+		// the bone hierarchy, bind pose and clips, every further skeleton with that fingerprint only gets its own
+		// bones (the per instance pose state) and references the layout and Animation objects of the first one.
+		// The Animation objects are owned by the layout, so libraries loaded onto it reach later skeletons too.
+		// A rig is dropped again once the last skeleton using its layout goes away.
+		class RigCache
+		{
+		public:
+			static RigCache *GetSharedInstance();
+			
+			// Fills the skeleton's animations and registers the shared layout for it, returns false for unknown rigs
+			bool Acquire(uint64 fingerprint, Skeleton *skeleton);
+			void Add(uint64 fingerprint, SkeletonLayout *layout);
+			
+			// Called when the last skeleton of a layout goes away, keeps the rig if another skeleton acquired it meanwhile
+			void RemoveUnusedRig(SkeletonLayout *layout);
+			
+			size_t GetRigCount();
+			void Clear();
+			
+		private:
+			RigCache();
+			
+			std::mutex _lock;
+			std::unordered_map<uint64, SkeletonLayout *> _rigs;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_RIGCACHE__ */
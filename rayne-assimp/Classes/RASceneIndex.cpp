@@ -0,0 +1,80 @@
+//
+//  RASceneIndex.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RASceneIndex.h"
+#include "RAHash.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: SceneIndex
+		// ---------------------
+		
+		SceneIndex::SceneIndex(const aiScene *scene)
+		{
+			if(!scene->mRootNode)
+				return;
+			
+			Node root;
+			root.node = scene->mRootNode;
+			root.hash = HashName(root.node->mName);
+			root.parent = InvalidIndex;
+			
+			_nodes.push_back(root);
+			
+			for(size_t i = 0; i < _nodes.size(); i ++)
+			{
+				aiNode *ainode = _nodes[i].node;
+				_lookup.insert(std::make_pair(_nodes[i].hash, i));
+				
+				for(unsigned int c = 0; c < ainode->mNumChildren; c ++)
+				{
+					Node child;
+					child.node = ainode->mChildren[c];
+					child.hash = HashName(child.node->mName);
+					child.parent = i;
+					
+					_nodes[i].children.push_back(_nodes.size());
+					_nodes.push_back(child);
+				}
+			}
+		}
+		
+		uint64 SceneIndex::HashName(const aiString &name)
+		{
+			return HashBytes(name.data, name.length);
+		}
+		
+		size_t SceneIndex::FindNode(const aiString &name) const
+		{
+			// Duplicate names resolve to the shallowest node
+			size_t result = InvalidIndex;
+			auto range = _lookup.equal_range(HashName(name));
+			
+			for(auto iterator = range.first; iterator != range.second; iterator ++)
+			{
+				if(iterator->second < result && _nodes[iterator->second].node->mName == name)
+					result = iterator->second;
+			}
+			
+			return result;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+//
+//  RASceneIndex.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_SCENEINDEX__
+#define __RAYNE_ASSIMP_SCENEINDEX__
+
+#include <Rayne/Rayne.h>
+#include <assimp/scene.h>
+#include <unordered_map>
+
+namespace RN
+{
+	namespace assimp
+	{
+		class SceneIndex
+		{
+		public:
+			static const size_t InvalidIndex = static_cast<size_t>(-1);
+			
+			struct Node
+			{
+				aiNode *node;
+				uint64 hash;
+				size_t parent;
+				std::vector<size_t> children;
+				std::vector<size_t> bones; // Skeleton bones that were created for this node
+			};
+			
+			// Nodes are stored breadth first, every parent comes before its children
+			SceneIndex(const aiScene *scene);
+			
+			size_t FindNode(const aiString &name) const;
+			size_t GetNodeCount() const { return _nodes.size(); }
+			const Node &GetNode(size_t index) const { return _nodes[index]; }
+			
+			void AddBone(size_t node, size_t bone) { _nodes[node].bones.push_back(bone); }
+			
+			static uint64 HashName(const aiString &name);
+			
+		private:
+			std::vector<Node> _nodes;
+			std::unordered_multimap<uint64, size_t> _lookup;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_SCENEINDEX__ */
@@ -0,0 +1,147 @@
+//
+//  RAShaderManifest.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAShaderManifest.h"
+#include <fstream>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: ShaderManifest
+		// ---------------------
+		
+		ShaderManifest::ShaderManifest() :
+			_dirty(false)
+		{}
+		
+		ShaderManifest *ShaderManifest::GetSharedInstance()
+		{
+			static ShaderManifest *instance = new ShaderManifest();
+			return instance;
+		}
+		
+		std::string ShaderManifest::GetSignature(std::vector<std::string> defines)
+		{
+			std::sort(defines.begin(), defines.end());
+			defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+			
+			std::string signature;
+			
+			for(const std::string &define : defines)
+			{
+				if(!signature.empty())
+					signature += ";";
+				
+				signature += define;
+			}
+			
+			return signature;
+		}
+		
+		void ShaderManifest::SetPath(const std::string &path)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_path = path;
+			
+			std::ifstream stream(path);
+			std::string line;
+			
+			// One signature per line, prefixed with a marker so the empty define set survives as well
+			while(std::getline(stream, line))
+			{
+				if(!line.empty() && line[0] == '>')
+					_signatures.insert(line.substr(1));
+			}
+		}
+		
+		bool ShaderManifest::Save()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(_path.empty() || !_dirty)
+				return true;
+			
+			std::ofstream stream(_path, std::ios::out | std::ios::trunc);
+			
+			for(const std::string &signature : _signatures)
+				stream << '>' << signature << '\n';
+			
+			if(!stream.good())
+				return false;
+			
+			_dirty = false;
+			return true;
+		}
+		
+		bool ShaderManifest::AddDefines(const std::vector<std::string> &defines)
+		{
+			std::string signature = GetSignature(defines);
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			bool inserted = _signatures.insert(signature).second;
+			_dirty = _dirty || inserted;
+			
+			return inserted;
+		}
+		
+		std::vector<std::vector<std::string>> ShaderManifest::GetDefineSets()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			std::vector<std::vector<std::string>> result;
+			
+			for(const std::string &signature : _signatures)
+			{
+				std::vector<std::string> defines;
+				std::stringstream stream(signature);
+				std::string define;
+				
+				while(std::getline(stream, define, ';'))
+					defines.push_back(define);
+				
+				result.push_back(std::move(defines));
+			}
+			
+			return result;
+		}
+		
+		std::future<size_t> ShaderManifest::Prewarm(Shader *shader)
+		{
+			std::vector<std::vector<std::string>> sets = GetDefineSets();
+			shader->Retain();
+			
+			return ThreadPool::GetSharedInstance()->AddTask([shader, sets]() -> size_t {
+				size_t compiled = 0;
+				
+				for(const std::vector<std::string> &defines : sets)
+				{
+					std::vector<ShaderDefine> shaderDefines;
+					for(const std::string &define : defines)
+						shaderDefines.push_back(ShaderDefine(define, ""));
+					
+					if(shader->GetProgramWithLookup(ShaderLookup(shaderDefines)))
+						compiled ++;
+				}
+				
+				shader->Release();
+				return compiled;
+			});
+		}
+	}
+}
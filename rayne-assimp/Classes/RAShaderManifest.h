@@ -0,0 +1,61 @@
+//
+//  RAShaderManifest.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_SHADERMANIFEST__
+#define __RAYNE_ASSIMP_SHADERMANIFEST__
+
+#include <Rayne/Rayne.h>
+#include <future>
+#include <mutex>
+#include <set>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Persistent list of every material define set the loader produced, so the shader permutations can be
+		// compiled up front (eg. behind a loading screen) instead of lazily on the first draw.
+		class ShaderManifest
+		{
+		public:
+			static ShaderManifest *GetSharedInstance();
+			
+			void SetPath(const std::string &path);
+			
+			// Returns false if the manifest couldn't be written, the in memory state stays dirty for the next try
+			bool Save();
+			
+			bool AddDefines(const std::vector<std::string> &defines);
+			std::vector<std::vector<std::string>> GetDefineSets();
+			
+			// Compiles on the thread pool, the future can be dropped without waiting for the work to finish
+			std::future<size_t> Prewarm(Shader *shader);
+			
+			static std::string GetSignature(std::vector<std::string> defines);
+			
+		private:
+			ShaderManifest();
+			
+			std::mutex _lock;
+			std::set<std::string> _signatures;
+			std::string _path;
+			bool _dirty;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_SHADERMANIFEST__ */
@@ -0,0 +1,445 @@
+//
+//  RASkeletonLayout.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RASkeletonLayout.h"
+#include "RALazyClip.h"
+#include "RARigCache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(SkeletonLayout, Object)
+		
+		static const char *kRASkeletonLayoutAssociatedKey = "kRASkeletonLayoutAssociatedKey";
+		
+		// Associated with a skeleton, keeps its layout alive and counts the skeleton as a user of it for as long as the skeleton lives
+		class SkeletonLayoutBinding : public Object
+		{
+		public:
+			SkeletonLayoutBinding(SkeletonLayout *layout) :
+				_layout(layout)
+			{
+				_layout->Retain();
+				
+				std::lock_guard<std::mutex> lock(_layout->_skeletonLock);
+				_layout->_skeletonCount ++;
+			}
+			
+			~SkeletonLayoutBinding() override
+			{
+				bool unused;
+				
+				{
+					std::lock_guard<std::mutex> lock(_layout->_skeletonLock);
+					unused = (-- _layout->_skeletonCount == 0);
+				}
+				
+				// The rig cache only keeps layouts that a live skeleton still uses
+				if(unused)
+					RigCache::GetSharedInstance()->RemoveUnusedRig(_layout);
+				
+				_layout->Release();
+			}
+			
+			SkeletonLayout *GetLayout() const { return _layout; }
+			
+		private:
+			SkeletonLayout *_layout;
+			
+			RNDeclareMeta(SkeletonLayoutBinding)
+		};
+		
+		RNDefineMeta(SkeletonLayoutBinding, Object)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: SkeletonLayout
+		// ---------------------
+		
+		SkeletonLayout::SkeletonLayout() :
+			_skeletonCount(0)
+		{}
+		
+		SkeletonLayout::~SkeletonLayout()
+		{
+			for(auto &pair : _animations)
+				pair.second->Release();
+			
+			for(auto &pair : _clips)
+				pair.second->Release();
+			
+			for(auto &pair : _palettes)
+				pair.second->Release();
+			
+			for(auto &pair : _variants)
+			{
+				for(Clip *clip : pair.second)
+				{
+					if(clip)
+						clip->Release();
+				}
+			}
+		}
+		
+		size_t SkeletonLayout::AddBone(int32 parent, NameID name)
+		{
+			if(parent >= static_cast<int32>(_parents.size()))
+				throw Exception(Exception::Type::InconsistencyException, "Bones must be added after their parent");
+			
+			size_t bone = _parents.size();
+			
+			_parents.push_back(parent);
+			_names.push_back(name);
+			_offsets.push_back(Matrix());
+			_bounded.push_back(false);
+			_boundsMin.push_back(Vector3());
+			_boundsMax.push_back(Vector3());
+			_bones.insert(std::make_pair(name, bone));
+			
+			return bone;
+		}
+		
+		bool SkeletonLayout::AddAnimation(NameID name, Animation *animation)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(!_animations.insert(std::make_pair(name, animation)).second)
+				return false;
+			
+			animation->Retain();
+			return true;
+		}
+		
+		bool SkeletonLayout::AddClip(Clip *clip)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(!_clips.insert(std::make_pair(clip->GetName(), clip)).second)
+				return false;
+			
+			clip->Retain();
+			return true;
+		}
+		
+		bool SkeletonLayout::AddClipVariant(Clip *clip, size_t level)
+		{
+			if(level == 0)
+				return AddClip(clip);
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			std::vector<Clip *> &variants = _variants[clip->GetName()];
+			if(variants.size() < level)
+				variants.resize(level, nullptr);
+			
+			if(variants[level - 1])
+				return false;
+			
+			clip->Retain();
+			variants[level - 1] = clip;
+			
+			return true;
+		}
+		
+		void SkeletonLayout::AddBoneMask(size_t stage, const std::vector<bool> &mask)
+		{
+			if(mask.size() != _parents.size())
+				throw Exception(Exception::Type::InconsistencyException, "Bone mask doesn't match the skeleton layout");
+			
+			// Merges into a copy, readers keep the mask they got from GetBoneMask()
+			std::vector<bool> *merged = new std::vector<bool>(mask);
+			BoneMask result(merged);
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(_masks.size() <= stage)
+				_masks.resize(stage + 1);
+			
+			if(_masks[stage])
+			{
+				const std::vector<bool> &existing = *_masks[stage];
+				
+				for(size_t i = 0; i < existing.size(); i ++)
+				{
+					if(existing[i])
+						(*merged)[i] = true;
+				}
+			}
+			
+			_masks[stage] = result;
+		}
+		
+		SkeletonLayout::BoneMask SkeletonLayout::GetBoneMask(size_t stage) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return (stage < _masks.size()) ? _masks[stage] : BoneMask();
+		}
+		
+		bool SkeletonLayout::AddBoneBounds(size_t bone, const AABB &bounds)
+		{
+			Vector3 minimum = bounds.position + bounds.minExtend;
+			Vector3 maximum = bounds.position + bounds.maxExtend;
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			bool added = !_bounded[bone];
+			
+			if(!added)
+			{
+				minimum = Vector3(std::min(minimum.x, _boundsMin[bone].x), std::min(minimum.y, _boundsMin[bone].y), std::min(minimum.z, _boundsMin[bone].z));
+				maximum = Vector3(std::max(maximum.x, _boundsMax[bone].x), std::max(maximum.y, _boundsMax[bone].y), std::max(maximum.z, _boundsMax[bone].z));
+			}
+			
+			_bounded[bone] = true;
+			_boundsMin[bone] = minimum;
+			_boundsMax[bone] = maximum;
+			
+			return added;
+		}
+		
+		bool SkeletonLayout::HasBoneBounds(size_t bone) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return _bounded[bone];
+		}
+		
+		AABB SkeletonLayout::GetBoneBounds(size_t bone) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return AABB(_boundsMin[bone], _boundsMax[bone]);
+		}
+		
+		bool SkeletonLayout::HasBounds() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return (std::find(_bounded.begin(), _bounded.end(), true) != _bounded.end());
+		}
+		
+		AABB SkeletonLayout::TransformBounds(const Matrix *global) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			Vector3 minimum;
+			Vector3 maximum;
+			bool empty = true;
+			
+			for(size_t i = 0; i < _bounded.size(); i ++)
+			{
+				if(!_bounded[i])
+					continue;
+				
+				// Transform the center and widen the half extents by the absolute matrix, which is the tight box around the rotated one
+				const float *m = global[i].m;
+				Vector3 center = (_boundsMin[i] + _boundsMax[i]) * 0.5f;
+				Vector3 extents = (_boundsMax[i] - _boundsMin[i]) * 0.5f;
+				
+				float c[3];
+				float e[3];
+				
+				for(size_t row = 0; row < 3; row ++)
+				{
+					c[row] = m[row] * center.x + m[4 + row] * center.y + m[8 + row] * center.z + m[12 + row];
+					e[row] = std::fabs(m[row]) * extents.x + std::fabs(m[4 + row]) * extents.y + std::fabs(m[8 + row]) * extents.z;
+				}
+				
+				Vector3 boneMin(c[0] - e[0], c[1] - e[1], c[2] - e[2]);
+				Vector3 boneMax(c[0] + e[0], c[1] + e[1], c[2] + e[2]);
+				
+				if(empty)
+				{
+					minimum = boneMin;
+					maximum = boneMax;
+					empty = false;
+					continue;
+				}
+				
+				minimum = Vector3(std::min(minimum.x, boneMin.x), std::min(minimum.y, boneMin.y), std::min(minimum.z, boneMin.z));
+				maximum = Vector3(std::max(maximum.x, boneMax.x), std::max(maximum.y, boneMax.y), std::max(maximum.z, boneMax.z));
+			}
+			
+			return AABB(minimum, maximum);
+		}
+		
+		void SkeletonLayout::SetClipBounds(NameID name, const AABB &bounds)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_clipBounds[name] = bounds;
+		}
+		
+		bool SkeletonLayout::GetClipBounds(NameID name, AABB &bounds) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _clipBounds.find(name);
+			if(iterator == _clipBounds.end())
+				return false;
+			
+			bounds = iterator->second;
+			return true;
+		}
+		
+		bool SkeletonLayout::AddPalette(SkinningPalette *palette)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			if(!_palettes.insert(std::make_pair(palette->GetName(), palette)).second)
+				return false;
+			
+			palette->Retain();
+			return true;
+		}
+		
+		size_t SkeletonLayout::FindBone(NameID name) const
+		{
+			auto iterator = _bones.find(name);
+			return (iterator != _bones.end()) ? iterator->second : InvalidIndex;
+		}
+		
+		Animation *SkeletonLayout::FindAnimation(NameID name) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _animations.find(name);
+			return (iterator != _animations.end()) ? iterator->second : nullptr;
+		}
+		
+		Clip *SkeletonLayout::FindClip(NameID name) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _clips.find(name);
+			return (iterator != _clips.end()) ? iterator->second : nullptr;
+		}
+		
+		Clip *SkeletonLayout::FindClip(NameID name, size_t level) const
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				auto iterator = _variants.find(name);
+				if(iterator != _variants.end())
+				{
+					const std::vector<Clip *> &variants = iterator->second;
+					
+					for(size_t i = std::min(level, variants.size()); i > 0; i --)
+					{
+						if(variants[i - 1])
+							return variants[i - 1];
+					}
+				}
+			}
+			
+			return FindClip(name);
+		}
+		
+		SkinningPalette *SkeletonLayout::FindPalette(NameID name) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _palettes.find(name);
+			return (iterator != _palettes.end()) ? iterator->second : nullptr;
+		}
+		
+		size_t SkeletonLayout::EvictClips(float unusedSeconds)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			size_t count = 0;
+			
+			for(auto &pair : _clips)
+			{
+				LazyClip *clip = dynamic_cast<LazyClip *>(pair.second);
+				if(clip && clip->Evict(unusedSeconds))
+					count ++;
+			}
+			
+			return count;
+		}
+		
+		void SkeletonLayout::ComputeGlobalMatrices(const Matrix *local, Matrix *global) const
+		{
+			const int32 *parents = _parents.data();
+			size_t count = _parents.size();
+			
+			for(size_t i = 0; i < count; i ++)
+				global[i] = (parents[i] >= 0) ? global[parents[i]] * local[i] : local[i];
+		}
+		
+		void SkeletonLayout::ComputeGlobalMatrices(const Matrix *local, Matrix *global, const std::vector<bool> &mask) const
+		{
+			const int32 *parents = _parents.data();
+			size_t count = _parents.size();
+			
+			// Masks contain the ancestors of every bone they keep, so a kept bone never reads a skipped one
+			for(size_t i = 0; i < count; i ++)
+			{
+				if(mask[i])
+					global[i] = (parents[i] >= 0) ? global[parents[i]] * local[i] : local[i];
+			}
+		}
+		
+		void SkeletonLayout::SetLayoutForSkeleton(Skeleton *skeleton, SkeletonLayout *layout)
+		{
+			SkeletonLayoutBinding *binding = new SkeletonLayoutBinding(layout);
+			skeleton->SetAssociatedObject(kRASkeletonLayoutAssociatedKey, binding, Object::MemoryPolicy::Retain);
+			binding->Release();
+		}
+		
+		SkeletonLayout *SkeletonLayout::GetLayoutForSkeleton(Skeleton *skeleton)
+		{
+			Object *binding = skeleton->GetAssociatedObject(kRASkeletonLayoutAssociatedKey);
+			return binding ? binding->Downcast<SkeletonLayoutBinding>()->GetLayout() : nullptr;
+		}
+		
+		void SkeletonLayout::SyncAnimations(Skeleton *skeleton) const
+		{
+			NameTable *names = NameTable::GetSharedInstance();
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			for(auto &pair : _animations)
+			{
+				// Each skeleton holds its own reference, animations the skeleton already has by that name win
+				if(skeleton->animations.insert(std::make_pair(names->GetName(pair.first), pair.second)).second)
+					pair.second->Retain();
+			}
+		}
+		
+		size_t SkeletonLayout::GetSkeletonCount() const
+		{
+			std::lock_guard<std::mutex> lock(_skeletonLock);
+			return _skeletonCount;
+		}
+		
+		void SkeletonLayout::RemoveLayoutForSkeleton(Skeleton *skeleton)
+		{
+			skeleton->RemoveAssociatedObject(kRASkeletonLayoutAssociatedKey);
+		}
+		
+		Skeleton *SkeletonLayout::CopySkeleton(Skeleton *skeleton)
+		{
+			Skeleton *copy = skeleton->Copy();
+			
+			SkeletonLayout *layout = GetLayoutForSkeleton(skeleton);
+			if(layout)
+				SetLayoutForSkeleton(copy, layout);
+			
+			return copy;
+		}
+	}
+}
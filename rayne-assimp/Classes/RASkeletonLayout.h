@@ -0,0 +1,146 @@
+//
+//  RASkeletonLayout.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_SKELETONLAYOUT__
+#define __RAYNE_ASSIMP_SKELETONLAYOUT__
+
+#include <Rayne/Rayne.h>
+#include "RANameTable.h"
+#include "RAClip.h"
+#include "RASkinningPalette.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace RN
+{
+	namespace assimp
+	{
+		class SkeletonLayoutBinding;
+		
+		// Flat description of a loaded skeleton. Bones are stored parent before child, so the
+		// local to global pass is a single forward loop over the parent table. Bones and clips
+		// are looked up by their interned NameID instead of comparing strings.
+		// Layouts are shared through the rig cache and animation libraries add to them on loader
+		// threads, so the animation, clip and palette maps, the bone masks and the bone boxes are locked. Map
+		// entries are never replaced, pointers returned by the Find functions stay valid as long as the layout.
+		class SkeletonLayout : public Object
+		{
+		public:
+			friend class SkeletonLayoutBinding;
+			
+			static const size_t InvalidIndex = static_cast<size_t>(-1);
+			
+			typedef std::shared_ptr<const std::vector<bool>> BoneMask;
+			
+			SkeletonLayout();
+			~SkeletonLayout() override;
+			
+			size_t AddBone(int32 parent, NameID name);
+			
+			// Return false and leave the existing entry alone if the name is already taken
+			bool AddAnimation(NameID name, Animation *animation);
+			bool AddClip(Clip *clip);
+			bool AddPalette(SkinningPalette *palette);
+			bool AddClipVariant(Clip *clip, size_t level);
+			
+			// Bones a LOD stage needs, masks of the same stage are merged so shared layouts stay valid for every model.
+			// Merging replaces the stage's mask, a mask returned earlier stays readable but misses later additions.
+			void AddBoneMask(size_t stage, const std::vector<bool> &mask);
+			BoneMask GetBoneMask(size_t stage) const;
+			
+			// Inverse bind matrix, moves mesh space vertices into the bone's space
+			void SetBoneOffset(size_t bone, const Matrix &offset) { _offsets[bone] = offset; }
+			const Matrix &GetBoneOffset(size_t bone) const { return _offsets[bone]; }
+			
+			// Bone space box around the vertices a bone influences, boxes of every mesh skinned to the layout are merged
+			// Returns true if the bone had no box before.
+			bool AddBoneBounds(size_t bone, const AABB &bounds);
+			bool HasBoneBounds(size_t bone) const;
+			AABB GetBoneBounds(size_t bone) const;
+			bool HasBounds() const;
+			
+			// Model space box of the skinned meshes for a full pose of global matrices
+			AABB TransformBounds(const Matrix *global) const;
+			
+			// Union of the pose bounds over the sampled frames of a clip including its last pose, padded by half
+			// of the largest step between two samples to cover the poses in between
+			void SetClipBounds(NameID name, const AABB &bounds);
+			bool GetClipBounds(NameID name, AABB &bounds) const;
+			
+			size_t GetBoneCount() const { return _parents.size(); }
+			int32 GetParent(size_t bone) const { return _parents[bone]; }
+			NameID GetBoneName(size_t bone) const { return _names[bone]; }
+			const std::vector<int32> &GetParents() const { return _parents; }
+			
+			size_t FindBone(NameID name) const;
+			Animation *FindAnimation(NameID name) const;
+			Clip *FindClip(NameID name) const;
+			
+			// Level 0 is the full rate clip, missing levels fall back to the next finer one
+			Clip *FindClip(NameID name, size_t level) const;
+			SkinningPalette *FindPalette(NameID name) const;
+			
+			// Drops the decoded keys of lazily loaded clips that weren't sampled for the given time
+			size_t EvictClips(float unusedSeconds);
+			
+			void ComputeGlobalMatrices(const Matrix *local, Matrix *global) const;
+			void ComputeGlobalMatrices(const Matrix *local, Matrix *global, const std::vector<bool> &mask) const;
+			
+			// The layout is an associated object of the skeleton and lives as long as it does
+			static void SetLayoutForSkeleton(Skeleton *skeleton, SkeletonLayout *layout);
+			static SkeletonLayout *GetLayoutForSkeleton(Skeleton *skeleton);
+			static void RemoveLayoutForSkeleton(Skeleton *skeleton);
+			
+			// Skeleton::Copy() doesn't carry associated objects, this copies the skeleton together with its layout
+			static Skeleton *CopySkeleton(Skeleton *skeleton);
+			
+			// Live skeletons the layout is set for
+			size_t GetSkeletonCount() const;
+			
+			// Adds the layout's animations the skeleton doesn't have yet. Animation libraries only add to the layout,
+			// a library loaded in the background reaches the skeletons sharing it once this is called on the thread
+			// that updates them.
+			void SyncAnimations(Skeleton *skeleton) const;
+			
+		private:
+			std::vector<int32> _parents; // -1 for root bones
+			std::vector<NameID> _names;
+			std::vector<Matrix> _offsets;
+			
+			std::unordered_map<NameID, size_t> _bones;
+			
+			mutable std::mutex _lock;
+			std::vector<BoneMask> _masks; // Per LOD stage, null for stages without a mask
+			std::vector<bool> _bounded;
+			std::vector<Vector3> _boundsMin;
+			std::vector<Vector3> _boundsMax;
+			std::unordered_map<NameID, Animation *> _animations;
+			std::unordered_map<NameID, Clip *> _clips;
+			std::unordered_map<NameID, std::vector<Clip *>> _variants; // Level 1 and up
+			std::unordered_map<NameID, SkinningPalette *> _palettes;
+			std::unordered_map<NameID, AABB> _clipBounds;
+			
+			mutable std::mutex _skeletonLock;
+			size_t _skeletonCount;
+			
+			RNDeclareMeta(SkeletonLayout)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_SKELETONLAYOUT__ */
@@ -0,0 +1,259 @@
+//
+//  RASkinningPalette.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RASkinningPalette.h"
+#include "RASkeletonLayout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#define kRASkinningPaletteMagic   0x50534152 // 'RASP'
+#define kRASkinningPaletteVersion 1
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(SkinningPalette, Object)
+		
+		// ---------------------
+		// MARK: -
+		// MARK: SkinningPalette
+		// ---------------------
+		
+		SkinningPalette::SkinningPalette(NameID name, size_t boneCount, float duration, float sampleRate, bool halfFloat) :
+			_name(name),
+			_boneCount(boneCount),
+			_frameCount(std::max<size_t>(static_cast<size_t>(std::ceil(duration * sampleRate)), 1)),
+			_duration(duration),
+			_sampleRate(sampleRate),
+			_halfFloat(halfFloat)
+		{
+			_data.resize(_frameCount * GetFrameSize());
+		}
+		
+		SkinningPalette *SkinningPalette::Bake(const Clip *clip, const SkeletonLayout *layout, float duration, float sampleRate, bool halfFloat)
+		{
+			size_t boneCount = layout->GetBoneCount();
+			if(clip->GetBoneCount() != boneCount)
+				throw Exception(Exception::Type::InconsistencyException, "Clip doesn't match the skeleton layout");
+			
+			SkinningPalette *palette = new SkinningPalette(clip->GetName(), boneCount, duration, sampleRate, halfFloat);
+			
+			std::vector<Vector3> positions(boneCount);
+			std::vector<Quaternion> rotations(boneCount);
+			std::vector<Vector3> scales(boneCount);
+			
+			std::vector<Matrix> local(boneCount);
+			std::vector<Matrix> global(boneCount);
+			
+			clip->WaitUntilResident();
+			
+			for(size_t frame = 0; frame < palette->_frameCount; frame ++)
+			{
+				clip->Sample(frame / sampleRate, positions.data(), rotations.data(), scales.data());
+				
+				for(size_t bone = 0; bone < boneCount; bone ++)
+					local[bone] = Matrix::WithTranslation(positions[bone]) * Matrix::WithRotation(rotations[bone]) * Matrix::WithScaling(scales[bone]);
+				
+				layout->ComputeGlobalMatrices(local.data(), global.data());
+				
+				for(size_t bone = 0; bone < boneCount; bone ++)
+					palette->SetMatrix(frame, bone, global[bone] * layout->GetBoneOffset(bone));
+			}
+			
+			return palette;
+		}
+		
+		size_t SkinningPalette::GetFrameIndex(float time) const
+		{
+			if(_duration <= 0.0f)
+				return 0;
+			
+			// The last frame covers the rest of the clip up to its duration, which may be shorter than a full frame
+			time = std::fmod(time, _duration);
+			if(time < 0.0f)
+				time += _duration;
+			
+			return std::min(static_cast<size_t>(time * _sampleRate), _frameCount - 1);
+		}
+		
+		void SkinningPalette::SetMatrix(size_t frame, size_t bone, const Matrix &matrix)
+		{
+			// Matrices are column major, the palette keeps the top three rows
+			float rows[12];
+			for(size_t row = 0; row < 3; row ++)
+			{
+				for(size_t column = 0; column < 4; column ++)
+					rows[row * 4 + column] = matrix.m[column * 4 + row];
+			}
+			
+			uint8 *target = &_data[frame * GetFrameSize()];
+			
+			if(_halfFloat)
+			{
+				uint16 *values = reinterpret_cast<uint16 *>(target) + bone * 12;
+				for(size_t i = 0; i < 12; i ++)
+					values[i] = FloatToHalf(rows[i]);
+			}
+			else
+			{
+				std::memcpy(reinterpret_cast<float *>(target) + bone * 12, rows, sizeof(rows));
+			}
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Half floats
+		// ---------------------
+		
+		uint16 SkinningPalette::FloatToHalf(float value)
+		{
+			uint32 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			
+			uint16 sign = static_cast<uint16>((bits >> 16) & 0x8000);
+			int32 exponent = static_cast<int32>((bits >> 23) & 0xff) - 127 + 15;
+			uint32 mantissa = bits & 0x7fffff;
+			
+			if(((bits >> 23) & 0xff) == 0xff)
+				return sign | 0x7c00 | (mantissa ? 0x200 : 0); // Infinity and NaN
+			
+			if(exponent >= 31)
+				return sign | 0x7c00;
+			
+			if(exponent <= 0)
+			{
+				if(exponent < -10)
+					return sign;
+				
+				// Denormal, shift the implicit one in and round to nearest
+				mantissa |= 0x800000;
+				uint32 shift = static_cast<uint32>(14 - exponent);
+				uint32 result = mantissa >> shift;
+				
+				if((mantissa >> (shift - 1)) & 1)
+					result ++;
+				
+				return sign | static_cast<uint16>(result);
+			}
+			
+			uint32 result = (static_cast<uint32>(exponent) << 10) | (mantissa >> 13);
+			
+			// Round to nearest, a carry into the exponent is still the correctly rounded value
+			if(mantissa & 0x1000)
+				result ++;
+			
+			return sign | static_cast<uint16>(std::min<uint32>(result, 0x7c00));
+		}
+		
+		float SkinningPalette::HalfToFloat(uint16 value)
+		{
+			uint32 sign = static_cast<uint32>(value & 0x8000) << 16;
+			uint32 exponent = (value >> 10) & 0x1f;
+			uint32 mantissa = value & 0x3ff;
+			uint32 bits;
+			
+			if(exponent == 0)
+			{
+				if(mantissa == 0)
+				{
+					bits = sign;
+				}
+				else
+				{
+					// Denormal, normalize it for the wider exponent range
+					exponent = 127 - 15 + 1;
+					while(!(mantissa & 0x400))
+					{
+						mantissa <<= 1;
+						exponent --;
+					}
+					
+					bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+				}
+			}
+			else if(exponent == 31)
+			{
+				bits = sign | 0x7f800000 | (mantissa << 13);
+			}
+			else
+			{
+				bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+			}
+			
+			float result;
+			std::memcpy(&result, &bits, sizeof(result));
+			
+			return result;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Baked cache
+		// ---------------------
+		
+		bool SkinningPalette::ReadFromFile(const std::string &path)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			if(!stream.is_open())
+				return false;
+			
+			uint32 header[5];
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			
+			if(!stream.good() || header[0] != kRASkinningPaletteMagic || header[1] != kRASkinningPaletteVersion)
+				return false;
+			
+			if(header[2] != _boneCount || header[3] != _frameCount || header[4] != static_cast<uint32>(_halfFloat))
+				return false;
+			
+			std::vector<uint8> data(_data.size());
+			stream.read(reinterpret_cast<char *>(data.data()), data.size());
+			
+			if(!stream.good())
+				return false;
+			
+			_data = std::move(data);
+			return true;
+		}
+		
+		void SkinningPalette::WriteToFile(const std::string &path) const
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			uint32 header[5] = { kRASkinningPaletteMagic, kRASkinningPaletteVersion, static_cast<uint32>(_boneCount), static_cast<uint32>(_frameCount), static_cast<uint32>(_halfFloat) };
+			stream.write(reinterpret_cast<const char *>(header), sizeof(header));
+			stream.write(reinterpret_cast<const char *>(_data.data()), _data.size());
+			
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				throw Exception(Exception::Type::GenericException, "Couldn't write skinning palette " + path);
+			}
+			
+			std::remove(path.c_str());
+			if(std::rename(temporary.c_str(), path.c_str()) != 0)
+				throw Exception(Exception::Type::GenericException, "Couldn't write skinning palette " + path);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+//
+//  RASkinningPalette.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_SKINNINGPALETTE__
+#define __RAYNE_ASSIMP_SKINNINGPALETTE__
+
+#include <Rayne/Rayne.h>
+#include "RAClip.h"
+
+namespace RN
+{
+	namespace assimp
+	{
+		class SkeletonLayout;
+		
+		// Final skinning matrices of a clip sampled at a fixed rate, for characters that don't need a runtime
+		// pose. Every frame holds one row major 3x4 matrix (12 values) per bone, as floats or half floats,
+		// and frames are stored one after another so a renderer can upload or index a frame directly.
+		class SkinningPalette : public Object
+		{
+		public:
+			// The duration is the source clip's, the palette loops with the same period even if it isn't a whole number of frames
+			SkinningPalette(NameID name, size_t boneCount, float duration, float sampleRate, bool halfFloat);
+			
+			// Returns a new palette covering [0, duration) of the clip, the last frame wraps to the first
+			static SkinningPalette *Bake(const Clip *clip, const SkeletonLayout *layout, float duration, float sampleRate, bool halfFloat);
+			
+			NameID GetName() const { return _name; }
+			size_t GetBoneCount() const { return _boneCount; }
+			size_t GetFrameCount() const { return _frameCount; }
+			float GetDuration() const { return _duration; }
+			float GetSampleRate() const { return _sampleRate; }
+			bool IsHalfFloat() const { return _halfFloat; }
+			
+			size_t GetFrameIndex(float time) const;
+			size_t GetFrameSize() const { return _boneCount * 12 * (_halfFloat ? sizeof(uint16) : sizeof(float)); }
+			const uint8 *GetFrame(size_t frame) const { return &_data[frame * GetFrameSize()]; }
+			size_t GetMemorySize() const { return _data.size(); }
+			
+			// Baked cache, reading fails if the file is missing or doesn't match the palette's layout
+			bool ReadFromFile(const std::string &path);
+			void WriteToFile(const std::string &path) const;
+			
+			static uint16 FloatToHalf(float value);
+			static float HalfToFloat(uint16 value);
+			
+		private:
+			void SetMatrix(size_t frame, size_t bone, const Matrix &matrix);
+			
+			NameID _name;
+			size_t _boneCount;
+			size_t _frameCount;
+			float _duration;
+			float _sampleRate;
+			bool _halfFloat;
+			
+			std::vector<uint8> _data;
+			
+			RNDeclareMeta(SkinningPalette)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_SKINNINGPALETTE__ */
@@ -0,0 +1,314 @@
+//
+//  RAStreamedClip.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RAStreamedClip.h"
+#include "RAClipRange.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#define kRAStreamedClipMagic   0x53534152 // 'RASS'
+#define kRAStreamedClipVersion 2
+
+namespace RN
+{
+	namespace assimp
+	{
+		RNDefineMeta(StreamedClip, Clip)
+		RNDefineMeta(StreamCursor, Object)
+		
+		struct StreamedClipHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint32 boneCount;
+			uint32 frameCount;
+			uint32 blockFrames;
+			uint32 blockCount;
+			float sampleRate;
+			float duration;
+		};
+		
+		// Positions, rotations and scales of blockFrames + 1 frames, bone major like AnimationClip
+		static size_t GetBlockFloats(size_t boneCount, size_t blockFrames)
+		{
+			return boneCount * (blockFrames + 1) * 10;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: StreamedClip
+		// ---------------------
+		
+		StreamedClip::StreamedClip(NameID name, const std::string &path, size_t windowBlocks) :
+			Clip(name, 0),
+			_path(path),
+			_windowBlocks(std::max<size_t>(windowBlocks, 1))
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			
+			StreamedClipHeader header;
+			stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+			
+			if(!stream.good() || header.magic != kRAStreamedClipMagic || header.version != kRAStreamedClipVersion || header.blockFrames == 0)
+				throw Exception(Exception::Type::GenericException, "Couldn't read streamed animation clip " + path);
+			
+			_boneCount = header.boneCount;
+			_frameCount = header.frameCount;
+			_blockFrames = header.blockFrames;
+			_blockCount = header.blockCount;
+			_sampleRate = header.sampleRate;
+			_duration = header.duration;
+		}
+		
+		size_t StreamedClip::GetMemorySize() const
+		{
+			return sizeof(StreamedClip) + GetResidentBlockCount() * GetBlockFloats(_boneCount, _blockFrames) * sizeof(float);
+		}
+		
+		size_t StreamedClip::GetResidentBlockCount() const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return _window.size();
+		}
+		
+		StreamedClip::BlockData StreamedClip::ReadBlock(const std::string &path, size_t block, size_t floats)
+		{
+			std::vector<float> *data = new std::vector<float>(floats);
+			BlockData result(data);
+			
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			stream.seekg(sizeof(StreamedClipHeader) + block * floats * sizeof(float));
+			stream.read(reinterpret_cast<char *>(data->data()), floats * sizeof(float));
+			
+			if(!stream.good())
+				throw Exception(Exception::Type::GenericException, "Couldn't read streamed animation clip " + path);
+			
+			return result;
+		}
+		
+		void StreamedClip::RequestBlock(Window &window, size_t block) const
+		{
+			if(window.find(block) != window.end())
+				return;
+			
+			// The task only captures values, so it may outlive the cursor and the clip that requested it
+			std::string path = _path;
+			size_t floats = GetBlockFloats(_boneCount, _blockFrames);
+			
+			window[block] = ThreadPool::GetSharedInstance()->AddTask([path, block, floats]() -> BlockData {
+				return ReadBlock(path, block, floats);
+			}).share();
+		}
+		
+		void StreamedClip::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			SampleWindow(_window, time, 0.0f, GetDuration(), positions, rotations, scales);
+		}
+		
+		void StreamedClip::SampleWindow(Window &window, float time, float start, float end, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const
+		{
+			size_t firstBlock = std::min(static_cast<size_t>(start * _sampleRate) / _blockFrames, _blockCount - 1);
+			size_t lastBlock = std::max(std::min(static_cast<size_t>(end * _sampleRate) / _blockFrames, _blockCount - 1), firstBlock);
+			size_t span = lastBlock - firstBlock + 1;
+			
+			float position = GetFramePosition(start + WrapTime(time, end - start), _duration, _sampleRate, _frameCount);
+			size_t frame = std::min(static_cast<size_t>(position), _frameCount - 1);
+			float factor = std::min(position - frame, 1.0f);
+			
+			size_t block = std::min(std::max(frame / _blockFrames, firstBlock), lastBlock);
+			size_t local = std::min(frame - std::min(frame, block * _blockFrames), _blockFrames);
+			size_t next = std::min(local + 1, _blockFrames);
+			size_t offset = block - firstBlock;
+			
+			// The window starts at the playhead and wraps around within the sampled range like the time does
+			for(auto iterator = window.begin(); iterator != window.end();)
+			{
+				size_t distance = span;
+				if(iterator->first >= firstBlock && iterator->first <= lastBlock)
+					distance = (iterator->first - firstBlock + span - offset) % span;
+				
+				if(distance >= _windowBlocks)
+					iterator = window.erase(iterator);
+				else
+					iterator ++;
+			}
+			
+			for(size_t i = 0; i < std::min(_windowBlocks, span); i ++)
+				RequestBlock(window, firstBlock + (offset + i) % span);
+			
+			BlockData data = window[block].get();
+			
+			size_t frames = _blockFrames + 1;
+			const float *blockPositions = data->data();
+			const float *blockRotations = blockPositions + _boneCount * frames * 3;
+			const float *blockScales = blockRotations + _boneCount * frames * 4;
+			
+			for(size_t bone = 0; bone < _boneCount; bone ++)
+			{
+				const float *p = blockPositions + bone * frames * 3;
+				const float *r = blockRotations + bone * frames * 4;
+				const float *s = blockScales + bone * frames * 3;
+				
+				float position[3];
+				float rotation[4];
+				float scale[3];
+				
+				InterpolateVector(p + local * 3, p + next * 3, factor, position);
+				InterpolateRotation(r + local * 4, r + next * 4, factor, rotation);
+				InterpolateVector(s + local * 3, s + next * 3, factor, scale);
+				
+				positions[bone] = Vector3(position[0], position[1], position[2]);
+				rotations[bone] = Quaternion(rotation[0], rotation[1], rotation[2], rotation[3]);
+				scales[bone] = Vector3(scale[0], scale[1], scale[2]);
+			}
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: StreamCursor
+		// ---------------------
+		
+		StreamCursor::StreamCursor(StreamedClip *clip) :
+			_clip(clip),
+			_start(0.0f),
+			_end(clip->GetDuration())
+		{
+			_clip->Retain();
+		}
+		
+		StreamCursor::StreamCursor(StreamedClip *clip, float start, float end) :
+			_clip(clip),
+			_start(start),
+			_end(end)
+		{
+			_clip->Retain();
+		}
+		
+		StreamCursor *StreamCursor::CreateForClip(Clip *clip)
+		{
+			StreamedClip *streamed = dynamic_cast<StreamedClip *>(clip);
+			if(streamed)
+				return new StreamCursor(streamed);
+			
+			ClipRange *range = dynamic_cast<ClipRange *>(clip);
+			if(range)
+			{
+				streamed = dynamic_cast<StreamedClip *>(range->GetSource());
+				if(streamed)
+					return new StreamCursor(streamed, range->GetStart(), range->GetEnd());
+			}
+			
+			return nullptr;
+		}
+		
+		StreamCursor::~StreamCursor()
+		{
+			_clip->Release();
+		}
+		
+		size_t StreamCursor::GetMemorySize() const
+		{
+			return sizeof(StreamCursor) + _window.size() * GetBlockFloats(_clip->GetBoneCount(), _clip->_blockFrames) * sizeof(float);
+		}
+		
+		void StreamCursor::Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales)
+		{
+			_clip->SampleWindow(_window, time, _start, _end, positions, rotations, scales);
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Baked cache
+		// ---------------------
+		
+		bool StreamedClip::IsValidFile(const std::string &path, size_t boneCount)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+			if(!stream.is_open())
+				return false;
+			
+			size_t size = static_cast<size_t>(stream.tellg());
+			stream.seekg(0);
+			
+			StreamedClipHeader header;
+			stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+			
+			if(!stream.good() || header.magic != kRAStreamedClipMagic || header.version != kRAStreamedClipVersion)
+				return false;
+			
+			if(header.boneCount != boneCount || header.blockFrames == 0 || header.blockCount == 0 || header.frameCount < 2)
+				return false;
+			
+			// A truncated write has a good header but misses blocks at the end
+			return (size == sizeof(header) + header.blockCount * GetBlockFloats(header.boneCount, header.blockFrames) * sizeof(float));
+		}
+		
+		void StreamedClip::WriteToFile(const std::string &path, const AnimationClip *clip, size_t blockFrames)
+		{
+			size_t boneCount = clip->GetBoneCount();
+			size_t frameCount = clip->GetFrameCount();
+			size_t blockCount = std::max<size_t>((frameCount - 1 + blockFrames - 1) / blockFrames, 1);
+			
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			StreamedClipHeader header = { kRAStreamedClipMagic, kRAStreamedClipVersion, static_cast<uint32>(boneCount), static_cast<uint32>(frameCount), static_cast<uint32>(blockFrames), static_cast<uint32>(blockCount), clip->GetSampleRate(), clip->GetDuration() };
+			stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			
+			std::vector<float> data;
+			data.reserve(GetBlockFloats(boneCount, blockFrames));
+			
+			for(size_t block = 0; block < blockCount; block ++)
+			{
+				data.clear();
+				
+				// The last block repeats the final frame to keep every block the same size
+				for(size_t component = 0; component < 3; component ++)
+				{
+					size_t width = (component == 1) ? 4 : 3;
+					
+					for(size_t bone = 0; bone < boneCount; bone ++)
+					{
+						const float *values = (component == 0) ? clip->GetPositions(bone) : ((component == 1) ? clip->GetRotations(bone) : clip->GetScales(bone));
+						
+						for(size_t i = 0; i <= blockFrames; i ++)
+						{
+							size_t frame = std::min(block * blockFrames + i, frameCount - 1);
+							data.insert(data.end(), values + frame * width, values + (frame + 1) * width);
+						}
+					}
+				}
+				
+				stream.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(float));
+			}
+			
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				throw Exception(Exception::Type::GenericException, "Couldn't write streamed animation clip " + path);
+			}
+			
+			std::remove(path.c_str());
+			if(std::rename(temporary.c_str(), path.c_str()) != 0)
+				throw Exception(Exception::Type::GenericException, "Couldn't write streamed animation clip " + path);
+		}
+	}
+}
@@ -0,0 +1,113 @@
+//
+//  RAStreamedClip.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_STREAMEDCLIP__
+#define __RAYNE_ASSIMP_STREAMEDCLIP__
+
+#include <Rayne/Rayne.h>
+#include "RAAnimationClip.h"
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace RN
+{
+	namespace assimp
+	{
+		class StreamCursor;
+		
+		// Fixed rate clip that stays in the baked cache and is read in blocks of frames. Sampling loads the block
+		// under the playhead and pages the following ones in on the thread pool, blocks outside of that window
+		// are dropped, so the resident size is bounded no matter how long the clip runs. The window belongs to a
+		// StreamCursor, every playing instance needs its own so playheads of a shared clip don't evict each other.
+		class StreamedClip : public Clip
+		{
+		public:
+			friend class StreamCursor;
+			
+			// Throws if the file isn't a baked stream
+			StreamedClip(NameID name, const std::string &path, size_t windowBlocks);
+			
+			float GetDuration() const override { return _duration; }
+			size_t GetMemorySize() const override;
+			
+			size_t GetBlockCount() const { return _blockCount; }
+			size_t GetResidentBlockCount() const;
+			
+			// Goes through the clip's own window, meant for one off sampling and not for playback
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const override;
+			
+			// Checks the header and the size, the file may be left over from an interrupted bake
+			static bool IsValidFile(const std::string &path, size_t boneCount);
+			
+			// Every block repeats the first frame of the next one, so interpolation never spans two blocks
+			static void WriteToFile(const std::string &path, const AnimationClip *clip, size_t blockFrames);
+			
+		private:
+			typedef std::shared_ptr<const std::vector<float>> BlockData;
+			typedef std::map<size_t, std::shared_future<BlockData>> Window;
+			
+			static BlockData ReadBlock(const std::string &path, size_t block, size_t floats);
+			void RequestBlock(Window &window, size_t block) const;
+			void SampleWindow(Window &window, float time, float start, float end, Vector3 *positions, Quaternion *rotations, Vector3 *scales) const;
+			
+			std::string _path;
+			size_t _frameCount;
+			float _duration;
+			size_t _blockFrames;
+			size_t _blockCount;
+			size_t _windowBlocks;
+			float _sampleRate;
+			
+			mutable std::mutex _lock;
+			mutable Window _window;
+			
+			RNDeclareMeta(StreamedClip)
+		};
+		
+		// Playback position in a streamed clip with its own window of resident blocks. Not thread safe, a cursor
+		// is meant to be sampled by the one character playing it. A cursor over a time range of the clip wraps
+		// around within the range and only pages in its blocks.
+		class StreamCursor : public Object
+		{
+		public:
+			StreamCursor(StreamedClip *clip);
+			StreamCursor(StreamedClip *clip, float start, float end);
+			~StreamCursor() override;
+			
+			// Cursor for a streamed clip or a ClipRange of one, nullptr for clips that aren't streamed
+			static StreamCursor *CreateForClip(Clip *clip);
+			
+			StreamedClip *GetClip() const { return _clip; }
+			size_t GetResidentBlockCount() const { return _window.size(); }
+			size_t GetMemorySize() const;
+			
+			void Sample(float time, Vector3 *positions, Quaternion *rotations, Vector3 *scales);
+			
+		private:
+			StreamedClip *_clip;
+			StreamedClip::Window _window;
+			float _start;
+			float _end;
+			
+			RNDeclareMeta(StreamCursor)
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_STREAMEDCLIP__ */
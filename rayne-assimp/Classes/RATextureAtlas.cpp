@@ -0,0 +1,237 @@
+//
+//  RATextureAtlas.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RATextureAtlas.h"
+#include <cstdio>
+#include <fstream>
+
+#define kRATextureAtlasMagic   0x54415241 // 'RAAT'
+#define kRATextureAtlasVersion 1
+
+namespace RN
+{
+	namespace assimp
+	{
+		// ---------------------
+		// MARK: -
+		// MARK: TextureAtlas
+		// ---------------------
+		
+		TextureAtlas::TextureAtlas(uint32 pageSize, uint32 padding) :
+			_pageSize(pageSize),
+			_padding(padding)
+		{}
+		
+		void TextureAtlas::Pack(std::vector<Image> &images)
+		{
+			// Shelf packing, tallest images first so the shelves waste as little height as possible
+			std::sort(images.begin(), images.end(), [](const Image &a, const Image &b) {
+				return (a.height != b.height) ? (a.height > b.height) : (a.width > b.width);
+			});
+			
+			uint32 shelfX = 0;
+			uint32 shelfY = 0;
+			uint32 shelfHeight = 0;
+			
+			for(const Image &image : images)
+			{
+				uint32 width  = image.width  + _padding * 2;
+				uint32 height = image.height + _padding * 2;
+				
+				if(width > _pageSize || height > _pageSize)
+					continue;
+				
+				if(_pages.empty())
+					_pages.emplace_back(_pageSize * _pageSize * 4, 0);
+				
+				if(shelfX + width > _pageSize)
+				{
+					shelfX = 0;
+					shelfY += shelfHeight;
+					shelfHeight = 0;
+				}
+				
+				if(shelfY + height > _pageSize)
+				{
+					_pages.emplace_back(_pageSize * _pageSize * 4, 0);
+					
+					shelfX = 0;
+					shelfY = 0;
+					shelfHeight = 0;
+				}
+				
+				Region region;
+				region.page   = static_cast<uint32>(_pages.size() - 1);
+				region.x      = shelfX + _padding;
+				region.y      = shelfY + _padding;
+				region.width  = image.width;
+				region.height = image.height;
+				
+				CopyImage(image, region);
+				_regions.insert(std::make_pair(image.name, region));
+				
+				shelfX += width;
+				shelfHeight = std::max(shelfHeight, height);
+			}
+		}
+		
+		void TextureAtlas::CopyImage(const Image &image, const Region &region)
+		{
+			std::vector<uint8> &page = _pages[region.page];
+			
+			int32 padding = static_cast<int32>(_padding);
+			int32 width   = static_cast<int32>(image.width);
+			int32 height  = static_cast<int32>(image.height);
+			
+			// The padding replicates the edge texels so filtering and lower mips don't bleed in neighbours
+			for(int32 y = -padding; y < height + padding; y ++)
+			{
+				int32 sourceY = std::min(std::max(y, 0), height - 1);
+				uint8 *target = &page[((region.y + y) * _pageSize + region.x - padding) * 4];
+				
+				for(int32 x = -padding; x < width + padding; x ++)
+				{
+					int32 sourceX = std::min(std::max(x, 0), width - 1);
+					const uint8 *source = &image.pixels[(sourceY * width + sourceX) * 4];
+					
+					std::copy(source, source + 4, target);
+					target += 4;
+				}
+			}
+		}
+		
+		bool TextureAtlas::GetRegion(const std::string &name, Region &region) const
+		{
+			auto iterator = _regions.find(name);
+			if(iterator == _regions.end())
+				return false;
+			
+			region = iterator->second;
+			return true;
+		}
+		
+		void TextureAtlas::TransformUV(const Region &region, float &u, float &v) const
+		{
+			float scale = 1.0f / _pageSize;
+			
+			u = (region.x + u * region.width) * scale;
+			v = (region.y + v * region.height) * scale;
+		}
+		
+		Texture *TextureAtlas::CreatePageTexture(size_t page) const
+		{
+			Texture::Parameter parameter;
+			parameter.format = Texture::Format::RGBA8888;
+			parameter.wrapMode = Texture::WrapMode::Clamp;
+			
+			Texture2D *texture = new Texture2D(parameter, false);
+			
+			Texture::PixelData data;
+			data.data = _pages[page].data();
+			data.width = _pageSize;
+			data.height = _pageSize;
+			data.format = Texture::Format::RGBA8888;
+			
+			texture->SetData(data);
+			texture->Autorelease();
+			
+			return texture;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Baked cache
+		// ---------------------
+		
+		bool TextureAtlas::ReadFromFile(const std::string &path)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary);
+			if(!stream.is_open())
+				return false;
+			
+			uint32 header[5];
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			
+			if(!stream.good() || header[0] != kRATextureAtlasMagic || header[1] != kRATextureAtlasVersion || header[2] != _pageSize)
+				return false;
+			
+			std::unordered_map<std::string, Region> regions;
+			std::vector<std::vector<uint8>> pages(header[3], std::vector<uint8>(_pageSize * _pageSize * 4));
+			
+			for(uint32 i = 0; i < header[4]; i ++)
+			{
+				uint32 length;
+				stream.read(reinterpret_cast<char *>(&length), sizeof(length));
+				
+				std::string name(length, '\0');
+				stream.read(&name[0], length);
+				
+				Region region;
+				stream.read(reinterpret_cast<char *>(&region), sizeof(region));
+				
+				if(!stream.good() || region.page >= pages.size())
+					return false;
+				
+				regions.insert(std::make_pair(name, region));
+			}
+			
+			for(std::vector<uint8> &page : pages)
+				stream.read(reinterpret_cast<char *>(page.data()), page.size());
+			
+			if(!stream.good())
+				return false;
+			
+			_regions = std::move(regions);
+			_pages = std::move(pages);
+			
+			return true;
+		}
+		
+		void TextureAtlas::WriteToFile(const std::string &path) const
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			uint32 header[5] = { kRATextureAtlasMagic, kRATextureAtlasVersion, _pageSize, static_cast<uint32>(_pages.size()), static_cast<uint32>(_regions.size()) };
+			stream.write(reinterpret_cast<const char *>(header), sizeof(header));
+			
+			for(auto &pair : _regions)
+			{
+				uint32 length = static_cast<uint32>(pair.first.length());
+				
+				stream.write(reinterpret_cast<const char *>(&length), sizeof(length));
+				stream.write(pair.first.data(), length);
+				stream.write(reinterpret_cast<const char *>(&pair.second), sizeof(Region));
+			}
+			
+			for(const std::vector<uint8> &page : _pages)
+				stream.write(reinterpret_cast<const char *>(page.data()), page.size());
+			
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				throw Exception(Exception::Type::GenericException, "Couldn't write texture atlas " + path);
+			}
+			
+			std::remove(path.c_str());
+			if(std::rename(temporary.c_str(), path.c_str()) != 0)
+				throw Exception(Exception::Type::GenericException, "Couldn't write texture atlas " + path);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+//
+//  RATextureAtlas.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_TEXTUREATLAS__
+#define __RAYNE_ASSIMP_TEXTUREATLAS__
+
+#include <Rayne/Rayne.h>
+#include <unordered_map>
+
+namespace RN
+{
+	namespace assimp
+	{
+		class TextureAtlas
+		{
+		public:
+			struct Image
+			{
+				std::string name;
+				uint32 width;
+				uint32 height;
+				std::vector<uint8> pixels; // RGBA8888
+			};
+			
+			struct Region
+			{
+				uint32 page;
+				uint32 x;
+				uint32 y;
+				uint32 width;
+				uint32 height;
+			};
+			
+			TextureAtlas(uint32 pageSize, uint32 padding);
+			
+			void Pack(std::vector<Image> &images);
+			
+			bool ReadFromFile(const std::string &path);
+			void WriteToFile(const std::string &path) const;
+			
+			bool GetRegion(const std::string &name, Region &region) const;
+			size_t GetPageCount() const { return _pages.size(); }
+			size_t GetRegionCount() const { return _regions.size(); }
+			
+			Texture *CreatePageTexture(size_t page) const;
+			void TransformUV(const Region &region, float &u, float &v) const;
+			
+		private:
+			void CopyImage(const Image &image, const Region &region);
+			
+			uint32 _pageSize;
+			uint32 _padding;
+			
+			std::vector<std::vector<uint8>> _pages;
+			std::unordered_map<std::string, Region> _regions;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_TEXTUREATLAS__ */
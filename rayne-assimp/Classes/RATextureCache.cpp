@@ -0,0 +1,632 @@
+//
+//  RATextureCache.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RATextureCache.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#define kRAMipChainMagic   0x504D4152 // 'RAMP'
+#define kRAMipChainVersion 1
+
+namespace RN
+{
+	namespace assimp
+	{
+		static bool FindTexturePath(const std::string &path, std::string &result)
+		{
+			result = path;
+			
+			try
+			{
+				result = FileManager::GetSharedInstance()->GetNormalizedPathFromFullpath(path);
+				return PathManager::PathExists(result);
+			}
+			catch(Exception e)
+			{
+				return false;
+			}
+		}
+		
+		static const float *GetSRGBTable()
+		{
+			static float table[256];
+			static std::once_flag flag;
+			
+			std::call_once(flag, []() {
+				for(int i = 0; i < 256; i ++)
+				{
+					float value = i / 255.0f;
+					table[i] = (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+				}
+			});
+			
+			return table;
+		}
+		
+		static uint8 EncodeSRGB(float value)
+		{
+			value = std::min(std::max(value, 0.0f), 1.0f);
+			value = (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			
+			return static_cast<uint8>(value * 255.0f + 0.5f);
+		}
+		
+		static uint8 EncodeUnorm(float value)
+		{
+			value = std::min(std::max(value, 0.0f), 1.0f);
+			return static_cast<uint8>(value * 255.0f + 0.5f);
+		}
+		
+		static void HalveImage(std::vector<uint8> &pixels, uint32 &width, uint32 &height, TextureCache::MipFilter filter)
+		{
+			uint32 halfWidth  = std::max(width  / 2, 1U);
+			uint32 halfHeight = std::max(height / 2, 1U);
+			
+			std::vector<uint8> result(halfWidth * halfHeight * 4);
+			const float *srgb = GetSRGBTable();
+			
+			for(uint32 y = 0; y < halfHeight; y ++)
+			{
+				uint32 y0 = std::min(y * 2, height - 1);
+				uint32 y1 = std::min(y * 2 + 1, height - 1);
+				
+				for(uint32 x = 0; x < halfWidth; x ++)
+				{
+					uint32 x0 = std::min(x * 2, width - 1);
+					uint32 x1 = std::min(x * 2 + 1, width - 1);
+					
+					const uint8 *source[4] = { &pixels[(y0 * width + x0) * 4], &pixels[(y0 * width + x1) * 4], &pixels[(y1 * width + x0) * 4], &pixels[(y1 * width + x1) * 4] };
+					uint8 *target = &result[(y * halfWidth + x) * 4];
+					
+					target[3] = static_cast<uint8>((source[0][3] + source[1][3] + source[2][3] + source[3][3] + 2) / 4);
+					
+					switch(filter)
+					{
+						case TextureCache::MipFilter::Linear:
+						{
+							for(uint32 c = 0; c < 3; c ++)
+								target[c] = static_cast<uint8>((source[0][c] + source[1][c] + source[2][c] + source[3][c] + 2) / 4);
+							
+							break;
+						}
+							
+						case TextureCache::MipFilter::Color:
+						{
+							// Average in linear space, averaging the sRGB encoded values darkens the lower mips
+							for(uint32 c = 0; c < 3; c ++)
+								target[c] = EncodeSRGB((srgb[source[0][c]] + srgb[source[1][c]] + srgb[source[2][c]] + srgb[source[3][c]]) * 0.25f);
+							
+							break;
+						}
+							
+						case TextureCache::MipFilter::Normal:
+						{
+							float normal[3] = { 0.0f, 0.0f, 0.0f };
+							
+							for(uint32 i = 0; i < 4; i ++)
+							{
+								for(uint32 c = 0; c < 3; c ++)
+									normal[c] += source[i][c] / 127.5f - 1.0f;
+							}
+							
+							float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+							if(length <= k::EpsilonFloat)
+							{
+								normal[0] = 0.0f;
+								normal[1] = 0.0f;
+								normal[2] = 1.0f;
+								length = 1.0f;
+							}
+							
+							for(uint32 c = 0; c < 3; c ++)
+								target[c] = EncodeUnorm((normal[c] / length) * 0.5f + 0.5f);
+							
+							break;
+						}
+					}
+				}
+			}
+			
+			pixels.swap(result);
+			
+			width  = halfWidth;
+			height = halfHeight;
+		}
+		
+		static bool ReadFileContents(const std::string &path, std::vector<uint8> &contents)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+			if(!stream.is_open())
+				return false;
+			
+			contents.resize(static_cast<size_t>(stream.tellg()));
+			
+			stream.seekg(0);
+			stream.read(reinterpret_cast<char *>(contents.data()), contents.size());
+			
+			return stream.good();
+		}
+		
+		static bool IsFileOfSize(const std::string &path, size_t size)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+			return (stream.is_open() && static_cast<size_t>(stream.tellg()) == size);
+		}
+		
+		// Readers only ever see complete files, an interrupted write leaves the temporary behind
+		static bool WriteFileContents(const std::string &path, const void *bytes, size_t length)
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			stream.write(static_cast<const char *>(bytes), length);
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				return false;
+			}
+			
+			std::remove(path.c_str());
+			return (std::rename(temporary.c_str(), path.c_str()) == 0);
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Request
+		// ---------------------
+		
+		TextureCache::Request::Request() :
+			filter(MipFilter::Color),
+			mipBias(0),
+			preprocess(false)
+		{}
+		
+		TextureCache::Request::Request(const std::string &tpath, aiTextureType aitexturetype) :
+			path(tpath),
+			filter(MipFilter::Color),
+			mipBias(0),
+			preprocess(false)
+		{
+			if(aitexturetype == aiTextureType_NORMALS)
+				filter = MipFilter::Normal;
+			else if(aitexturetype == aiTextureType_HEIGHT || aitexturetype == aiTextureType_DISPLACEMENT)
+				filter = MipFilter::Linear;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: TextureCache
+		// ---------------------
+		
+		TextureCache::TextureCache() :
+			_preferredExtensions({ "dds", "ktx" })
+		{}
+		
+		TextureCache *TextureCache::GetSharedInstance()
+		{
+			static TextureCache *instance = new TextureCache();
+			return instance;
+		}
+		
+		Texture *TextureCache::GetEmbeddedTexture(const aiTexture *aitexture, const std::string &cacheDirectory, bool linear)
+		{
+			bool compressed = (aitexture->mHeight == 0);
+			size_t length = compressed ? aitexture->mWidth : aitexture->mWidth * aitexture->mHeight * sizeof(aiTexel);
+			
+			uint64 hash = HashBytes(aitexture->pcData, length);
+			hash = HashBytes(&aitexture->mWidth, sizeof(aitexture->mWidth), hash);
+			hash = HashBytes(&aitexture->mHeight, sizeof(aitexture->mHeight), hash);
+			hash = HashBytes(&linear, sizeof(linear), hash);
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _embeddedTextures.find(hash);
+			if(iterator != _embeddedTextures.end())
+				return iterator->second;
+			
+			Texture *texture = compressed ? CreateCompressedTexture(aitexture, hash, cacheDirectory, linear) : CreateUncompressedTexture(aitexture, linear);
+			if(!texture)
+				return nullptr;
+			
+			_embeddedTextures.insert(std::make_pair(hash, texture));
+			return texture;
+		}
+		
+		Texture *TextureCache::GetTexture(const Request &request)
+		{
+			if(request.preprocess)
+				return GetPreprocessedTexture(request);
+			
+			if(request.mipBias > 0)
+				return GetTextureWithMipBias(request);
+			
+			return Texture::WithFile(request.path, request.IsLinear());
+		}
+		
+		Texture *TextureCache::GetFileTexture(const std::string &key)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _fileTextures.find(key);
+			return (iterator != _fileTextures.end()) ? iterator->second : nullptr;
+		}
+		
+		Texture *TextureCache::AddFileTexture(const std::string &key, Texture *texture)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto result = _fileTextures.insert(std::make_pair(key, texture));
+			if(!result.second)
+				texture->Release();
+			
+			return result.first->second;
+		}
+		
+		Texture *TextureCache::GetTextureWithMipBias(const Request &request)
+		{
+			std::stringstream key;
+			key << request.path << '\0' << static_cast<int>(request.filter) << '\0' << request.mipBias;
+			
+			Texture *texture = GetFileTexture(key.str());
+			if(texture)
+				return texture;
+			
+			// The source texture is only pulled in temporarily, the materials only ever reference the smaller copy
+			MipChain chain;
+			ReadSourceImage(request, chain);
+			
+			for(uint32 i = 0; i < request.mipBias && (chain.width > 1 || chain.height > 1); i ++)
+				HalveImage(chain.levels[0], chain.width, chain.height, request.filter);
+			
+			return AddFileTexture(key.str(), CreateTexture(chain, request.IsLinear(), true));
+		}
+		
+		Texture *TextureCache::GetPreprocessedTexture(const Request &request)
+		{
+			std::stringstream key;
+			key << request.path << '\0' << static_cast<int>(request.filter) << '\0' << request.mipBias << '\0' << "mips";
+			
+			Texture *texture = GetFileTexture(key.str());
+			if(texture)
+				return texture;
+			
+			std::vector<uint8> contents;
+			if(!ReadFileContents(request.path, contents))
+				throw Exception(Exception::Type::GenericException, "Couldn't read texture " + request.path);
+			
+			uint64 hash = HashBytes(contents.data(), contents.size());
+			hash = HashBytes(&request.filter, sizeof(request.filter), hash);
+			
+			std::stringstream name;
+			name << "mips-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+			
+			std::string path = PathManager::Join(request.cacheDirectory, name.str());
+			
+			MipChain chain;
+			if(!ReadMipChain(path, request.filter, request.mipBias, chain))
+			{
+				ReadSourceImage(request, chain);
+				
+				uint32 width  = chain.width;
+				uint32 height = chain.height;
+				
+				while(width > 1 || height > 1)
+				{
+					std::vector<uint8> level = chain.levels.back();
+					HalveImage(level, width, height, request.filter);
+					
+					chain.levels.push_back(std::move(level));
+				}
+				
+				// The chain in memory is complete either way, a failed write only costs the next run a rebuild
+				PathManager::CreatePath(request.cacheDirectory);
+				if(!WriteMipChain(path, request.filter, chain))
+					RNWarning("Couldn't write mip chain " << path);
+				
+				uint32 bias = std::min(request.mipBias, static_cast<uint32>(chain.levels.size() - 1));
+				
+				chain.levels.erase(chain.levels.begin(), chain.levels.begin() + bias);
+				chain.width  = std::max(chain.width  >> bias, 1U);
+				chain.height = std::max(chain.height >> bias, 1U);
+			}
+			
+			return AddFileTexture(key.str(), CreateTexture(chain, request.IsLinear(), false));
+		}
+		
+		void TextureCache::ReadSourceImage(const Request &request, MipChain &chain)
+		{
+			Texture *source = Texture::WithFile(request.path, request.IsLinear());
+			
+			chain.width  = source->GetWidth();
+			chain.height = source->GetHeight();
+			chain.levels.resize(1);
+			chain.levels[0].resize(chain.width * chain.height * 4);
+			
+			source->GetData(chain.levels[0].data(), Texture::Format::RGBA8888);
+		}
+		
+		Texture *TextureCache::CreateTexture(const MipChain &chain, bool linear, bool generateMipMaps)
+		{
+			Texture::Parameter parameter;
+			parameter.format = Texture::Format::RGBA8888;
+			parameter.generateMipMaps = generateMipMaps;
+			
+			Texture2D *texture = new Texture2D(parameter, linear);
+			
+			for(size_t i = 0; i < chain.levels.size(); i ++)
+			{
+				Texture::PixelData data;
+				data.data = chain.levels[i].data();
+				data.width = std::max(chain.width >> i, 1U);
+				data.height = std::max(chain.height >> i, 1U);
+				data.mipMapLevel = static_cast<uint32>(i);
+				data.format = Texture::Format::RGBA8888;
+				
+				texture->SetData(data);
+			}
+			
+			return texture;
+		}
+		
+		// ---------------------
+		// MARK: -
+		// MARK: Baked mip chains
+		// ---------------------
+		
+		bool TextureCache::ReadMipChain(const std::string &path, MipFilter filter, uint32 mipBias, MipChain &chain)
+		{
+			std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+			if(!stream.is_open())
+				return false;
+			
+			size_t size = static_cast<size_t>(stream.tellg());
+			stream.seekg(0);
+			
+			uint32 header[6];
+			stream.read(reinterpret_cast<char *>(header), sizeof(header));
+			
+			if(!stream.good() || header[0] != kRAMipChainMagic || header[1] != kRAMipChainVersion || header[2] != static_cast<uint32>(filter) || header[5] == 0)
+				return false;
+			
+			// A truncated file is a leftover of a broken write, the levels are only trusted if all of them are there
+			size_t expected = sizeof(header);
+			for(uint32 i = 0; i < header[5]; i ++)
+				expected += std::max(header[3] >> i, 1U) * std::max(header[4] >> i, 1U) * 4;
+			
+			if(size != expected)
+				return false;
+			
+			uint32 bias = std::min(mipBias, header[5] - 1);
+			
+			// Levels above the bias are skipped without reading them
+			size_t offset = 0;
+			for(uint32 i = 0; i < bias; i ++)
+				offset += std::max(header[3] >> i, 1U) * std::max(header[4] >> i, 1U) * 4;
+			
+			stream.seekg(offset, std::ios::cur);
+			
+			chain.width  = std::max(header[3] >> bias, 1U);
+			chain.height = std::max(header[4] >> bias, 1U);
+			chain.levels.resize(header[5] - bias);
+			
+			for(size_t i = 0; i < chain.levels.size(); i ++)
+			{
+				std::vector<uint8> &level = chain.levels[i];
+				level.resize(std::max(chain.width >> i, 1U) * std::max(chain.height >> i, 1U) * 4);
+				
+				stream.read(reinterpret_cast<char *>(level.data()), level.size());
+			}
+			
+			return stream.good();
+		}
+		
+		bool TextureCache::WriteMipChain(const std::string &path, MipFilter filter, const MipChain &chain)
+		{
+			std::string temporary = path + ".tmp";
+			std::ofstream stream(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+			
+			uint32 header[6] = { kRAMipChainMagic, kRAMipChainVersion, static_cast<uint32>(filter), chain.width, chain.height, static_cast<uint32>(chain.levels.size()) };
+			stream.write(reinterpret_cast<const char *>(header), sizeof(header));
+			
+			for(const std::vector<uint8> &level : chain.levels)
+				stream.write(reinterpret_cast<const char *>(level.data()), level.size());
+			
+			stream.close();
+			
+			if(stream.fail())
+			{
+				std::remove(temporary.c_str());
+				return false;
+			}
+			
+			std::remove(path.c_str());
+			return (std::rename(temporary.c_str(), path.c_str()) == 0);
+		}
+		
+		void TextureCache::RemoveFileTexture(Texture *texture)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			for(auto iterator = _fileTextures.begin(); iterator != _fileTextures.end();)
+			{
+				if(iterator->second == texture)
+				{
+					texture->Release();
+					iterator = _fileTextures.erase(iterator);
+				}
+				else
+				{
+					iterator ++;
+				}
+			}
+		}
+		
+		void TextureCache::RemoveAllTextures()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			for(auto &pair : _embeddedTextures)
+				pair.second->Release();
+			
+			for(auto &pair : _fileTextures)
+				pair.second->Release();
+			
+			_embeddedTextures.clear();
+			_fileTextures.clear();
+		}
+		
+		bool TextureCache::ResolveTexturePath(const std::string &directory, const aiString &aipath, aiTextureType aitexturetype, ResolvedPath &result)
+		{
+			std::string key(aipath.C_Str(), aipath.length);
+			key.push_back('\0');
+			key.push_back(static_cast<char>(aitexturetype));
+			
+			{
+				std::lock_guard<std::mutex> lock(_pathLock);
+				
+				ResolvedPathMap &paths = _resolvedPaths[directory];
+				auto iterator = paths.find(key);
+				
+				if(iterator != paths.end())
+				{
+					result = iterator->second;
+					return result.exists;
+				}
+			}
+			
+			// Resolve outside of the lock, this is the part that hits the filesystem
+			ResolvedPath resolved;
+			resolved.exists = false;
+			
+			BuildTexturePath(directory, aipath, resolved);
+			
+			{
+				std::lock_guard<std::mutex> lock(_pathLock);
+				_resolvedPaths[directory].insert(std::make_pair(key, resolved));
+			}
+			
+			result = resolved;
+			return resolved.exists;
+		}
+		
+		void TextureCache::BuildTexturePath(const std::string &directory, const aiString &aipath, ResolvedPath &resolved)
+		{
+			std::string base = PathManager::Join(directory, PathManager::Basename(aipath.C_Str()));
+			std::string extension = PathManager::Extension(aipath.C_Str());
+			
+			for(const std::string &preferred : GetPreferredExtensions())
+			{
+				if(preferred != extension && FindTexturePath(base + "." + preferred, resolved.path))
+				{
+					resolved.extension = preferred;
+					resolved.exists = true;
+					return;
+				}
+			}
+			
+			resolved.extension = extension;
+			resolved.exists = FindTexturePath(base + "." + extension, resolved.path);
+		}
+		
+		void TextureCache::SetPreferredExtensions(const std::vector<std::string> &extensions)
+		{
+			std::lock_guard<std::mutex> lock(_pathLock);
+			
+			_preferredExtensions = extensions;
+			_resolvedPaths.clear();
+		}
+		
+		std::vector<std::string> TextureCache::GetPreferredExtensions()
+		{
+			std::lock_guard<std::mutex> lock(_pathLock);
+			return _preferredExtensions;
+		}
+		
+		void TextureCache::InvalidateDirectory(const std::string &directory)
+		{
+			std::lock_guard<std::mutex> lock(_pathLock);
+			_resolvedPaths.erase(directory);
+		}
+		
+		void TextureCache::InvalidateAllDirectories()
+		{
+			std::lock_guard<std::mutex> lock(_pathLock);
+			_resolvedPaths.clear();
+		}
+		
+		Texture *TextureCache::CreateUncompressedTexture(const aiTexture *aitexture, bool linear)
+		{
+			size_t count = aitexture->mWidth * aitexture->mHeight;
+			std::vector<uint8> pixels(count * 4);
+			
+			// aiTexel is stored as BGRA
+			for(size_t i = 0; i < count; i ++)
+			{
+				const aiTexel &texel = aitexture->pcData[i];
+				
+				pixels[i * 4 + 0] = texel.r;
+				pixels[i * 4 + 1] = texel.g;
+				pixels[i * 4 + 2] = texel.b;
+				pixels[i * 4 + 3] = texel.a;
+			}
+			
+			Texture::Parameter parameter;
+			parameter.format = Texture::Format::RGBA8888;
+			
+			Texture2D *texture = new Texture2D(parameter, linear);
+			
+			Texture::PixelData data;
+			data.data = pixels.data();
+			data.width = aitexture->mWidth;
+			data.height = aitexture->mHeight;
+			data.format = Texture::Format::RGBA8888;
+			
+			texture->SetData(data);
+			return texture;
+		}
+		
+		Texture *TextureCache::CreateCompressedTexture(const aiTexture *aitexture, uint64 hash, const std::string &cacheDirectory, bool linear)
+		{
+			std::string hint(aitexture->achFormatHint, strnlen(aitexture->achFormatHint, 4));
+			if(hint.empty())
+				hint = "png";
+			
+			std::stringstream name;
+			name << std::hex << std::setw(16) << std::setfill('0') << hash << "." << hint;
+			
+			std::string path = PathManager::Join(cacheDirectory, name.str());
+			
+			// The name is content addressed, a file of the wrong size can only be a leftover of a broken write
+			if(!IsFileOfSize(path, aitexture->mWidth))
+			{
+				PathManager::CreatePath(cacheDirectory);
+				
+				if(!WriteFileContents(path, aitexture->pcData, aitexture->mWidth))
+				{
+					RNWarning("Couldn't write embedded texture " << path);
+					return nullptr;
+				}
+			}
+			
+			Texture *texture = Texture::WithFile(path, linear);
+			return static_cast<Texture *>(texture->Retain());
+		}
+	}
+}
@@ -0,0 +1,128 @@
+//
+//  RATextureCache.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_TEXTURECACHE__
+#define __RAYNE_ASSIMP_TEXTURECACHE__
+
+#include <Rayne/Rayne.h>
+#include <assimp/scene.h>
+#include <assimp/material.h>
+#include "RAHash.h"
+#include <unordered_map>
+#include <mutex>
+
+namespace RN
+{
+	namespace assimp
+	{
+		class TextureCache
+		{
+		public:
+			struct ResolvedPath
+			{
+				std::string path;
+				std::string extension;
+				bool exists;
+			};
+			
+			enum class MipFilter
+			{
+				Color,
+				Linear,
+				Normal
+			};
+			
+			struct Request
+			{
+				Request();
+				Request(const std::string &path, aiTextureType aitexturetype);
+				
+				bool IsLinear() const { return (filter != MipFilter::Color); }
+				
+				std::string path;
+				MipFilter filter;
+				uint32 mipBias;
+				
+				// Uses and fills the baked mip chain cache in cacheDirectory
+				bool preprocess;
+				std::string cacheDirectory;
+			};
+			
+			static TextureCache *GetSharedInstance();
+			
+			Texture *GetTexture(const Request &request);
+			
+			// Embedded textures are shared by content hash, compressed ones are decoded through a content addressed file.
+			// Returns nullptr if that file can't be written.
+			Texture *GetEmbeddedTexture(const aiTexture *aitexture, const std::string &cacheDirectory, bool linear);
+			
+			void RemoveAllTextures();
+			
+			// Drops the cache's reference to a biased or preprocessed texture, users holding their own keep it alive
+			void RemoveFileTexture(Texture *texture);
+			
+			// Resolves a material texture path relative to the model directory, misses are cached as well.
+			// Directory watchers must call InvalidateDirectory() when files are added, removed or renamed.
+			bool ResolveTexturePath(const std::string &directory, const aiString &aipath, aiTextureType aitexturetype, ResolvedPath &result);
+			void InvalidateDirectory(const std::string &directory);
+			void InvalidateAllDirectories();
+			
+			// Precompressed variants next to the source image are tried in this order before the source extension
+			void SetPreferredExtensions(const std::vector<std::string> &extensions);
+			std::vector<std::string> GetPreferredExtensions();
+			
+		private:
+			typedef std::unordered_map<std::string, ResolvedPath> ResolvedPathMap;
+			
+			TextureCache();
+			
+			void BuildTexturePath(const std::string &directory, const aiString &aipath, ResolvedPath &resolved);
+			
+			struct MipChain
+			{
+				uint32 width;
+				uint32 height;
+				std::vector<std::vector<uint8>> levels;
+			};
+			
+			Texture *GetTextureWithMipBias(const Request &request);
+			Texture *GetPreprocessedTexture(const Request &request);
+			
+			Texture *GetFileTexture(const std::string &key);
+			Texture *AddFileTexture(const std::string &key, Texture *texture);
+			
+			void ReadSourceImage(const Request &request, MipChain &chain);
+			Texture *CreateTexture(const MipChain &chain, bool linear, bool generateMipMaps);
+			
+			bool ReadMipChain(const std::string &path, MipFilter filter, uint32 mipBias, MipChain &chain);
+			bool WriteMipChain(const std::string &path, MipFilter filter, const MipChain &chain);
+			
+			Texture *CreateUncompressedTexture(const aiTexture *aitexture, bool linear);
+			Texture *CreateCompressedTexture(const aiTexture *aitexture, uint64 hash, const std::string &cacheDirectory, bool linear);
+			
+			std::mutex _lock;
+			std::unordered_map<uint64, Texture *> _embeddedTextures;
+			std::unordered_map<std::string, Texture *> _fileTextures;
+			
+			std::mutex _pathLock;
+			std::unordered_map<std::string, ResolvedPathMap> _resolvedPaths;
+			std::vector<std::string> _preferredExtensions;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_TEXTURECACHE__ */
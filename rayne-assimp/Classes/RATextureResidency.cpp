@@ -0,0 +1,273 @@
+//
+//  RATextureResidency.cpp
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "RATextureResidency.h"
+#include <algorithm>
+#include <set>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Associated with a model, the residency keeps its materials retained until the model goes away
+		class ResidencyModelMaterials : public Object
+		{
+		public:
+			ResidencyModelMaterials(const std::vector<Material *> &materials) :
+				_materials(materials)
+			{}
+			
+			~ResidencyModelMaterials() override
+			{
+				for(Material *material : _materials)
+					TextureResidency::GetSharedInstance()->RemoveMaterial(material);
+			}
+			
+		private:
+			std::vector<Material *> _materials;
+			
+			RNDeclareMeta(ResidencyModelMaterials)
+		};
+		
+		RNDefineMeta(ResidencyModelMaterials, Object)
+		
+		static const char *kRAResidencyModelMaterialsKey = "kRAResidencyModelMaterialsKey";
+		
+		// ---------------------
+		// MARK: -
+		// MARK: TextureResidency
+		// ---------------------
+		
+		TextureResidency::TextureResidency() :
+			_idleTime(30.0f)
+		{
+			_placeholders[0] = nullptr;
+			_placeholders[1] = nullptr;
+		}
+		
+		TextureResidency *TextureResidency::GetSharedInstance()
+		{
+			static TextureResidency *instance = new TextureResidency();
+			return instance;
+		}
+		
+		void TextureResidency::SetIdleTime(float seconds)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_idleTime = seconds;
+		}
+		
+		Texture *TextureResidency::GetPlaceholder(bool linear)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			Texture *&placeholder = _placeholders[linear ? 1 : 0];
+			if(!placeholder)
+			{
+				// Linear textures are normal maps and the like, a flat normal keeps the lighting stable until the real one arrives
+				uint8 pixel[4] = { 255, 255, 255, 255 };
+				if(linear)
+				{
+					pixel[0] = 128;
+					pixel[1] = 128;
+				}
+				
+				Texture::Parameter parameter;
+				parameter.format = Texture::Format::RGBA8888;
+				parameter.generateMipMaps = false;
+				
+				Texture2D *texture = new Texture2D(parameter, linear);
+				
+				Texture::PixelData data;
+				data.data = pixel;
+				data.width = 1;
+				data.height = 1;
+				data.format = Texture::Format::RGBA8888;
+				
+				texture->SetData(data);
+				placeholder = texture;
+			}
+			
+			return placeholder;
+		}
+		
+		void TextureResidency::AddDeferredTexture(Material *material, size_t index, const TextureCache::Request &request)
+		{
+			DeferredTexture deferred;
+			deferred.index = index;
+			deferred.request = request;
+			deferred.texture = nullptr;
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _materials.find(material);
+			if(iterator == _materials.end())
+			{
+				material->Retain();
+				iterator = _materials.insert(std::make_pair(material, std::vector<DeferredTexture>())).first;
+			}
+			
+			iterator->second.push_back(deferred);
+		}
+		
+		void TextureResidency::RemoveMaterial(Material *material)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _materials.find(material);
+			if(iterator == _materials.end())
+				return;
+			
+			std::vector<Texture *> textures;
+			for(DeferredTexture &deferred : iterator->second)
+			{
+				if(deferred.texture)
+					textures.push_back(deferred.texture);
+			}
+			
+			_materials.erase(iterator);
+			ReleaseTextures(textures);
+			
+			material->Release();
+		}
+		
+		void TextureResidency::AddModel(Model *model)
+		{
+			std::vector<Material *> materials;
+			
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				for(size_t stage = 0; stage < model->GetLODStageCount(); stage ++)
+				{
+					for(size_t i = 0; i < model->GetMeshCount(stage); i ++)
+					{
+						Material *material = model->GetMaterialAtIndex(stage, i);
+						
+						if(_materials.find(material) != _materials.end() && std::find(materials.begin(), materials.end(), material) == materials.end())
+							materials.push_back(material);
+					}
+				}
+			}
+			
+			if(materials.empty())
+				return;
+			
+			ResidencyModelMaterials *owner = new ResidencyModelMaterials(materials);
+			model->SetAssociatedObject(kRAResidencyModelMaterialsKey, owner, Object::MemoryPolicy::Retain);
+			owner->Release();
+		}
+		
+		void TextureResidency::MakeResident(Material *material)
+		{
+			std::vector<DeferredTexture> missing;
+			Clock::time_point now = Clock::now();
+			
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				
+				auto iterator = _materials.find(material);
+				if(iterator == _materials.end())
+					return;
+				
+				for(DeferredTexture &deferred : iterator->second)
+				{
+					deferred.lastUse = now;
+					
+					if(!deferred.texture)
+						missing.push_back(deferred);
+				}
+			}
+			
+			if(missing.empty())
+				return;
+			
+			// Decode and upload outside of the lock, other materials can still be touched meanwhile
+			for(DeferredTexture &deferred : missing)
+				deferred.texture = TextureCache::GetSharedInstance()->GetTexture(deferred.request);
+			
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			auto iterator = _materials.find(material);
+			if(iterator == _materials.end())
+				return;
+			
+			for(DeferredTexture &loaded : missing)
+			{
+				for(DeferredTexture &deferred : iterator->second)
+				{
+					if(deferred.index == loaded.index && !deferred.texture)
+					{
+						deferred.texture = loaded.texture;
+						deferred.texture->Retain();
+						
+						material->ReplaceTexture(deferred.texture, deferred.index);
+						break;
+					}
+				}
+			}
+		}
+		
+		size_t TextureResidency::EvictIdleTextures()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			
+			Clock::time_point now = Clock::now();
+			std::vector<Texture *> evicted;
+			
+			for(auto &pair : _materials)
+			{
+				for(DeferredTexture &deferred : pair.second)
+				{
+					if(!deferred.texture)
+						continue;
+					
+					std::chrono::duration<float> idle = now - deferred.lastUse;
+					if(idle.count() < _idleTime)
+						continue;
+					
+					Texture *placeholder = _placeholders[deferred.request.IsLinear() ? 1 : 0];
+					pair.first->ReplaceTexture(placeholder, deferred.index);
+					
+					evicted.push_back(deferred.texture);
+					deferred.texture = nullptr;
+				}
+			}
+			
+			ReleaseTextures(evicted);
+			return evicted.size();
+		}
+		
+		void TextureResidency::ReleaseTextures(const std::vector<Texture *> &textures)
+		{
+			// The cache shares textures between materials, it only lets go of those no resident material still uses
+			std::set<Texture *> candidates(textures.begin(), textures.end());
+			
+			for(auto &pair : _materials)
+			{
+				for(DeferredTexture &deferred : pair.second)
+					candidates.erase(deferred.texture);
+			}
+			
+			for(Texture *texture : candidates)
+				TextureCache::GetSharedInstance()->RemoveFileTexture(texture);
+			
+			for(Texture *texture : textures)
+				texture->Release();
+		}
+	}
+}
@@ -0,0 +1,79 @@
+//
+//  RATextureResidency.h
+//  rayne-assimp
+//
+//  Copyright 2013 by Überpixel. All rights reserved.
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+//  documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+//  PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+//  FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef __RAYNE_ASSIMP_TEXTURERESIDENCY__
+#define __RAYNE_ASSIMP_TEXTURERESIDENCY__
+
+#include <Rayne/Rayne.h>
+#include "RATextureCache.h"
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+
+namespace RN
+{
+	namespace assimp
+	{
+		// Materials loaded with "deferTextures" are bound to shared placeholders until the renderer integration
+		// calls MakeResident() for them, EvictIdleTextures() swaps textures unused for the idle time back out.
+		// Evicted textures also leave the texture cache once no resident material uses them anymore.
+		class TextureResidency
+		{
+		public:
+			static TextureResidency *GetSharedInstance();
+			
+			Texture *GetPlaceholder(bool linear);
+			
+			void AddDeferredTexture(Material *material, size_t index, const TextureCache::Request &request);
+			void RemoveMaterial(Material *material);
+			
+			// Removes the model's deferred materials once the model itself is deallocated
+			void AddModel(Model *model);
+			
+			void MakeResident(Material *material);
+			size_t EvictIdleTextures();
+			
+			void SetIdleTime(float seconds);
+			float GetIdleTime() const { return _idleTime; }
+			
+		private:
+			typedef std::chrono::steady_clock Clock;
+			
+			struct DeferredTexture
+			{
+				size_t index;
+				TextureCache::Request request;
+				
+				Texture *texture;
+				Clock::time_point lastUse;
+			};
+			
+			TextureResidency();
+			
+			// Expects the lock to be held
+			void ReleaseTextures(const std::vector<Texture *> &textures);
+			
+			std::mutex _lock;
+			std::unordered_map<Material *, std::vector<DeferredTexture>> _materials;
+			
+			Texture *_placeholders[2];
+			float _idleTime;
+		};
+	}
+}
+
+#endif /* __RAYNE_ASSIMP_TEXTURERESIDENCY__ */